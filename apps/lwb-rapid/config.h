@@ -54,14 +54,14 @@
 
 /* LWB configuration */
 #define LWB_SCHED_MIN_DELAY                 /* use the 'min delay' scheduler */
-#define LWB_CONF_SCHED_PERIOD_IDLE      30       /* define the period length */
+#define LWB_CONF_PERIOD_SCALE           8        /* time unit: 125ms */
+#define LWB_CONF_SCHED_PERIOD_IDLE      48       /* define the period length */
 #define LWB_CONF_USE_XMEM               0
 #define LWB_CONF_MAX_N_STREAMS          10
 #define LWB_CONF_OUT_BUFFER_SIZE        3
 #define LWB_CONF_IN_BUFFER_SIZE         2
 #define LWB_CONF_MAX_DATA_PKT_LEN       (LWB_CONF_MAX_PKT_LEN)
 #define LWB_CONF_MAX_DATA_SLOTS         2
-#define LWB_CONF_TIME_SCALE             5
 #define LWB_CONF_TX_CNT_DATA            2
 #define LWB_CONF_MAX_HOPS               3
 /* since the scheduler is simple, we can reduce the time for the computation */
@@ -101,7 +101,7 @@ PROCESS_THREAD(app_process, ev, data)
       low_stream_state = lwb_stream_get_state(1);
       if(low_stream_state == LWB_STREAM_STATE_INACTIVE) {
         /* request a stream with ID 1 and an IPI (inter packet interval) of
-         * LWB_CONF_SCHED_PERIOD_IDLE seconds, for periodic status messages */
+         * LWB_CONF_SCHED_PERIOD_IDLE time units, for periodic status msgs */
         lwb_stream_req_t 
         my_stream = { node_id,0, 1, LWB_CONF_SCHED_PERIOD_IDLE };
         if(!lwb_request_stream(&my_stream, 0)) {
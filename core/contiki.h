@@ -56,6 +56,7 @@
 /* custom files: */
 #include "lib/membx.h"
 #include "lib/fifo.h"
+#include "lib/bfifo.h"
 #include "net/lwb.h"
 #include "net/glossy.h"
 #include "net/nullmac.h"
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015, Swiss Federal Institute of Technology (ETH Zurich).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:  Reto Da Forno
+ */
+
+/**
+ * @addtogroup  lib
+ * @{
+ *
+ * @defgroup    bfifo First-in, first-out queue with variable-size elements
+ * @{
+ * 
+ * @file
+ *
+ * @brief First-in, first-out queue based on a linear byte array. Each 
+ * element (record) only occupies as many bytes as needed, records are never
+ * split at the end of the array (wrap-around).
+ * As the fifo lib, this lib provides address management only, i.e. it is 
+ * suitable for any type of memory. The length of a record must therefore be 
+ * stored by the user (e.g. as the first byte of the record) and passed to 
+ * bfifo_drop().
+ */
+
+#ifndef __BFIFO_H__
+#define __BFIFO_H__
+
+#include <string.h>
+
+#define BFIFO_ERROR     0xffffffff
+
+/**
+ * @brief declare a FIFO with variable-size elements
+ * @param size size of the memory block in bytes (max. 65535)
+ * @note It is the users responsibility to allocate a memory block of 'size'
+ * bytes starting at the address passed to bfifo_init().
+ */
+#define BFIFO(name, size) \
+  static struct bfifo name = { 0, size, size, 0, 0, 0, 0 }
+  
+struct bfifo {
+  uint32_t start;     /* start address of the array */
+  uint16_t size;      /* size of the array in bytes */
+  uint16_t end;       /* end of the valid data in front of the read pointer 
+                         (only relevant if the write pointer wrapped around) */
+  uint16_t read;      /* the read pointer (offset) */
+  uint16_t write;     /* the write pointer (offset) */
+  uint16_t resv;      /* offset of the reserved record */
+  uint16_t count;     /* number of records in the queue */
+};
+
+#define BFIFO_RESET(f)      ((f)->read = (f)->write = (f)->count = 0, \
+                             (f)->end = (f)->size)
+#define BFIFO_EMPTY(f)      ((f)->count == 0)
+/* write pointer has wrapped around (or queue is full) */
+#define BFIFO_WRAPPED(f)    ((f)->count && (f)->write <= (f)->read)
+#define BFIFO_READ_ADDR(f)  ((f)->start + (f)->read)
+#define BFIFO_RESV_ADDR(f)  ((f)->start + (f)->resv)
+/* number of bytes that can be read without wrap-around */
+#define BFIFO_CONTIG_READ(f) (BFIFO_EMPTY(f) ? 0 : \
+                              (BFIFO_WRAPPED(f) ? ((f)->end - (f)->read) : \
+                                                  ((f)->write - (f)->read)))
+
+static inline void
+bfifo_init(struct bfifo * const f, uint32_t start_addr)
+{
+  f->start = start_addr;
+  BFIFO_RESET(f);
+}
+
+/**
+ * @brief reserves a contiguous memory block for a record of len bytes 
+ * without occupying it (call bfifo_put() to commit the record)
+ * @return the start address of the reserved block or BFIFO_ERROR if there
+ * is not enough space
+ * @note only touches the write side of the queue, i.e. the consumer may 
+ * drain the queue while the reservation is held
+ */
+static inline uint32_t
+bfifo_reserve(struct bfifo * const f, uint16_t len) 
+{
+  if(BFIFO_WRAPPED(f)) {
+    if((f->read - f->write) < len) { return BFIFO_ERROR; }
+    f->resv = f->write;
+  } else if((f->size - f->write) >= len) {
+    f->resv = f->write;
+  } else if(f->read >= len || (BFIFO_EMPTY(f) && f->size >= len)) {
+    f->resv = 0;                /* wrap around */
+  } else {
+    return BFIFO_ERROR;
+  }
+  return BFIFO_RESV_ADDR(f);
+}
+
+/**
+ * @brief commits n records with a total length of len bytes, written to 
+ * the block obtained from bfifo_reserve()
+ * @param len the total length, must not exceed the reserved length
+ * @param n number of records
+ */
+static inline void
+bfifo_put_n(struct bfifo * const f, uint16_t len, uint16_t n) 
+{
+  if(BFIFO_EMPTY(f)) {
+    /* the queue may have been drained since the reservation was made */
+    f->read = f->resv;
+    f->end = f->size;
+  } else if(f->resv != f->write) {
+    f->end = f->write;          /* wrapped around, mark the end of the data */
+  }
+  f->write = f->resv + len;
+  f->count += n;
+}
+
+/**
+ * @brief commits a record of len bytes, written to the block obtained from 
+ * bfifo_reserve()
+ * @param len the length of the record, must not exceed the reserved length
+ */
+static inline void
+bfifo_put(struct bfifo * const f, uint16_t len) 
+{
+  bfifo_put_n(f, len, 1);
+}
+
+/**
+ * @brief delivers the address of the oldest record without removing it
+ * @return the address of the oldest record or BFIFO_ERROR if the queue is
+ * empty
+ */
+static inline uint32_t
+bfifo_peek(struct bfifo * const f) 
+{
+  if(BFIFO_EMPTY(f)) { return BFIFO_ERROR; }
+  return BFIFO_READ_ADDR(f);
+}
+
+/**
+ * @brief removes the oldest record from the queue
+ * @param len the length of the record in bytes
+ */
+static inline void
+bfifo_drop(struct bfifo * const f, uint16_t len) 
+{
+  if(BFIFO_EMPTY(f)) { return; }
+  f->read += len;
+  f->count--;
+  if(f->read >= f->end) {
+    /* continue at the beginning of the array */
+    f->read = 0;
+    f->end = f->size;
+  }
+}
+
+#endif /* __BFIFO_H__ */
+
+/**
+ * @}
+ * @}
+ */
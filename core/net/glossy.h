@@ -58,6 +58,16 @@
 #define GLOSSY_CONF_RETRANSMISSION_TIMEOUT      1
 #endif /* GLOSSY_CONF_RETRANSMISSION_TIMEOUT */
 
+/* whether the reference time should be the average over all synchronized 
+ * receptions and transmissions of a flood (instead of the first one only); 
+ * this yields a reference time with sub-tick resolution */
+#ifndef GLOSSY_CONF_T_REF_AVG
+#define GLOSSY_CONF_T_REF_AVG                   1
+#endif /* GLOSSY_CONF_T_REF_AVG */
+
+/* number of fractional bits of the reference time */
+#define GLOSSY_T_REF_FP                         8
+
 
 enum {
   GLOSSY_UNKNOWN_INITIATOR = 0
@@ -182,6 +192,13 @@ uint8_t glossy_is_t_ref_updated(void);
  */
 uint64_t glossy_get_t_ref(void);
 
+/**
+ * @brief get the fractional part of the reference time
+ * @return the fraction of a clock tick in units of 1/2^GLOSSY_T_REF_FP 
+ * (always 0 if GLOSSY_CONF_T_REF_AVG is disabled)
+ */
+uint8_t glossy_get_t_ref_frac(void);
+
 /**
  * @brief get the relay count of the first received packet
  */
@@ -40,12 +40,63 @@
  
 #include "contiki.h"
 
-#if LWB_VERSION == 1
 /*---------------------------------------------------------------------------*/
-#define LWB_DATA_PKT_HEADER_LEN     3  
+#if LWB_VERSION == 2 && LWB_CONF_AGGREGATE
+/* each message in a data packet is preceded by its length */
+#define LWB_DATA_PKT_PAYLOAD_LEN    (LWB_CONF_MAX_DATA_PKT_LEN - 1)
+#else /* LWB_VERSION */
 #define LWB_DATA_PKT_PAYLOAD_LEN    (LWB_CONF_MAX_DATA_PKT_LEN - \
                                      LWB_DATA_PKT_HEADER_LEN)
+#endif /* LWB_VERSION */
 #define STREAM_REQ_PKT_SIZE         5
+/* byte-wise access to the data packet header (may not be aligned) */
+#define LWB_PKT_RECIPIENT(p)        ((uint16_t)(p)[1] << 8 | (p)[0])
+#define LWB_PKT_SET_RECIPIENT(p, r) { (p)[0] = (uint8_t)(r); \
+                                      (p)[1] = (r) >> 8; }
+#define LWB_PKT_STREAM_ID(p)        ((p)[2])
+/* receive data packets directly into the incoming queue (not possible if the
+ * queue is in the external memory) */
+#define LWB_RX_ZERO_COPY            (!LWB_CONF_USE_XMEM)
+/* received messages can be delivered to the application in the middle of a
+ * round (not possible if the queue is in the external memory) */
+#define LWB_RX_NOTIFY               (!LWB_CONF_USE_XMEM && \
+                                     !LWB_CONF_RELAY_ONLY)
+/* size of each outgoing queue and the queue for the messages of a stream */
+#define LWB_OUT_QUEUE_BYTES         (LWB_CONF_OUT_BUFFER_BYTES / \
+                                     LWB_CONF_OUT_N_QUEUES)
+#define LWB_OUT_QUEUE(stream_id)    (&out_buffer[(stream_id) % \
+                                                 LWB_CONF_OUT_N_QUEUES])
+/* a stream request appended to a data packet (the node ID is omitted, it is 
+ * given by the owner of the data slot) */
+#define LWB_PIGGYBACK_SRQ_LEN       (LWB_STREAM_REQ_PKT_LEN - 3)
+#if LWB_CONF_PIGGYBACK_SRQ
+#define LWB_PIGGYBACK_SRQ_FLAG      0x80
+#else /* LWB_CONF_PIGGYBACK_SRQ */
+#define LWB_PIGGYBACK_SRQ_FLAG      0
+#endif /* LWB_CONF_PIGGYBACK_SRQ */
+/* does the data packet carry a stream request? (a packet with an invalid 
+ * stream ID carries nothing but the stream request) */
+#define LWB_PKT_HAS_SRQ(p)          ((p)[2] == LWB_INVALID_STREAM_ID || \
+                                     ((p)[2] & LWB_PIGGYBACK_SRQ_FLAG))
+/* aggregated data packets: header (recipient and LWB_AGGR_STREAM_ID) followed
+ * by the messages, each preceded by a sub-header (length and stream ID); in 
+ * version 2, all data packets consist of messages preceded by their length */
+#if LWB_VERSION == 2
+#define LWB_AGGR_SUBHDR_LEN         1
+#define LWB_PKT_IS_AGGR(p)          LWB_CONF_AGGREGATE
+#define LWB_PKT_DATA_STREAM_ID(p)   LWB_DEFAULT_STREAM_ID
+#else /* LWB_VERSION */
+#define LWB_AGGR_SUBHDR_LEN         2
+#define LWB_PKT_IS_AGGR(p)          (LWB_CONF_AGGREGATE && \
+                                     (p)[2] == LWB_AGGR_STREAM_ID)
+/* stream ID of the (first) message in a data packet */
+#define LWB_PKT_DATA_STREAM_ID(p)   (LWB_PKT_IS_AGGR(p) ? (p)[4] : (p)[2])
+#endif /* LWB_VERSION */
+/* stream IDs that can't be used for data messages */
+#define LWB_STREAM_ID_RESERVED(id)  ((id) == LWB_INVALID_STREAM_ID || \
+                                     ((id) & LWB_PIGGYBACK_SRQ_FLAG) || \
+                                     (LWB_CONF_AGGREGATE && \
+                                      (id) == LWB_AGGR_STREAM_ID))
 
 /* indicates when this node is about to send a request */
 #ifdef LWB_REQ_IND_PIN
@@ -68,6 +119,31 @@
   #define LWB_DATA_IND
 #endif /* LWB_CONF_DATA_IND_PIN */
 
+/* hands a received message over to the application right away (only polls
+ * the registered process, the message is processed after the slot) */
+#if LWB_RX_NOTIFY
+#define LWB_RX_NOTIFY_APP           { if(rx_proc) { process_poll(rx_proc); } }
+#else /* LWB_RX_NOTIFY */
+#define LWB_RX_NOTIFY_APP
+#endif /* LWB_RX_NOTIFY */
+
+/* executes op with interrupts disabled (restores the previous state) */
+#define LWB_ATOMIC(op) \
+{\
+  uint16_t gie = __get_interrupt_state() & GIE;\
+  __dint(); __nop();\
+  op;\
+  if(gie) { __eint(); __nop(); }\
+}
+/* the application may access the queues while a round is ongoing if it is
+ * notified about received messages: don't let the LWB task interrupt the 
+ * update of a queue */
+#if LWB_RX_NOTIFY
+#define LWB_QUEUE_ATOMIC(op)        LWB_ATOMIC(op)
+#else /* LWB_RX_NOTIFY */
+#define LWB_QUEUE_ATOMIC(op)        { op; }
+#endif /* LWB_RX_NOTIFY */
+
 /* is executed before each data slot */
 #ifndef LWB_DATA_SLOT_STARTS
 #define LWB_DATA_SLOT_STARTS
@@ -82,6 +158,7 @@ typedef enum {
   MISSED,
   UNSYNCED,
   UNSYNCED2,
+  RESYNC,
   NUM_OF_SYNC_STATES
 } lwb_sync_state_t;
 /*---------------------------------------------------------------------------*/
@@ -93,12 +170,25 @@ typedef enum {
 } sync_event_t; 
 /*---------------------------------------------------------------------------*/
 typedef struct {
+#if LWB_VERSION == 1
   uint16_t recipient;     /* target node ID */
   uint8_t  stream_id;     /* message type and connection ID (used as stream ID
                              in LWB); first bit is msg type */
+#endif /* LWB_VERSION */
   uint8_t  payload[LWB_DATA_PKT_PAYLOAD_LEN];       
 } lwb_data_pkt_t;
 /*---------------------------------------------------------------------------*/
+#if LWB_CONF_DATA_ACK
+#define LWB_DACK_BITMAP_LEN         ((LWB_CONF_MAX_DATA_SLOTS + 7) / 8)
+#define LWB_DACK_PKT_HEADER_LEN     2
+/* data acknowledgement: one bit per data slot of the previous round, set if 
+ * the host received a packet in this slot */
+typedef struct {
+  uint16_t time;          /* lower 16 bits of the time of the acked round */
+  uint8_t  bitmap[LWB_DACK_BITMAP_LEN];
+} lwb_dack_pkt_t;
+#endif /* LWB_CONF_DATA_ACK */
+/*---------------------------------------------------------------------------*/
 typedef struct {  
   /* be aware of structure alignment (8-bit are aligned to 8-bit, 16 to 16 etc)
    * the first 3 bytes of a glossy packet are always node_id and stream_id */
@@ -112,6 +202,9 @@ typedef struct {
       uint8_t reserved2[LWB_CONF_MAX_PKT_LEN - LWB_STREAM_REQ_PKT_LEN];
     };
     lwb_stream_ack_t sack_pkt;
+#if LWB_CONF_DATA_ACK
+    lwb_dack_pkt_t dack_pkt;
+#endif /* LWB_CONF_DATA_ACK */
     uint8_t raw_data[LWB_CONF_MAX_PKT_LEN];
   };
 } glossy_payload_t;
@@ -120,28 +213,36 @@ typedef struct {
  * @brief the finite state machine for the time synchronization on a source 
  * node the next state can be retrieved from the current state (column) and
  * the latest event (row)
- * @note  undefined transitions force the SM to go back into bootstrap
+ * @note  undefined transitions force the SM to go back into bootstrap (or 
+ * into resync if the node was synchronized before)
  */
 #if LWB_CONF_SKIP_QUASI_SYNCED
 #define AFTER_BOOT      SYNCED
 #else
 #define AFTER_BOOT      QUASI_SYNCED
 #endif
+#if LWB_CONF_RESYNC_ROUNDS
+#define SYNC_LOST       RESYNC
+#else
+#define SYNC_LOST       BOOTSTRAP
+#endif
 static const 
 lwb_sync_state_t next_state[NUM_OF_SYNC_EVENTS][NUM_OF_SYNC_STATES] = 
-{/* STATES:                                                                               EVENTS:           */
- /* BOOTSTRAP,  QUASISYNCED,  SYNCED,    SYNCED2,   MISSED,    UNSYNCED,  UNSYNCED2                         */
-  { AFTER_BOOT, SYNCED,       BOOTSTRAP, SYNCED,    SYNCED,    BOOTSTRAP, SYNCED    }, /* 1st schedule rcvd */
-  { BOOTSTRAP,  QUASI_SYNCED, SYNCED_2,  BOOTSTRAP, BOOTSTRAP, SYNCED_2,  BOOTSTRAP }, /* 2nd schedule rcvd */
-  { BOOTSTRAP,  BOOTSTRAP,    MISSED,    UNSYNCED,  UNSYNCED,  UNSYNCED2, BOOTSTRAP }  /* schedule missed   */
+{/* STATES:                                                                                           EVENTS:           */
+ /* BOOTSTRAP,  QUASISYNCED,  SYNCED,    SYNCED2,   MISSED,    UNSYNCED,  UNSYNCED2, RESYNC                         */
+  { AFTER_BOOT, SYNCED,       SYNC_LOST, SYNCED,    SYNCED,    SYNC_LOST, SYNCED,    QUASI_SYNCED }, /* 1st schedule rcvd */
+  { BOOTSTRAP,  QUASI_SYNCED, SYNCED_2,  SYNC_LOST, SYNC_LOST, SYNCED_2,  SYNC_LOST, RESYNC       }, /* 2nd schedule rcvd */
+  { BOOTSTRAP,  BOOTSTRAP,    MISSED,    UNSYNCED,  UNSYNCED,  UNSYNCED2, SYNC_LOST, RESYNC       }  /* schedule missed   */
 };
 /* note: syn2 = already synced */
 static const char* lwb_sync_state_to_string[NUM_OF_SYNC_STATES] = 
-{ "BOOTSTRAP", "QSYN", "SYN", "SYN2", "MISS", "USYN", "USYN2" };
+{ "BOOTSTRAP", "QSYN", "SYN", "SYN2", "MISS", "USYN", "USYN2", "RSYN" };
+#if !LWB_CONF_ADAPTIVE_GUARD
 static const uint32_t guard_time[NUM_OF_SYNC_STATES] = {
-/* STATE:      BOOTSTRAP,        QUASI_SYNCED,      SYNCED,           SYNCED_2,         MISSED,             UNSYNCED,           UNSYNCED2 */
-/* T_GUARD: */ LWB_CONF_T_GUARD, LWB_CONF_T_GUARD,  LWB_CONF_T_GUARD, LWB_CONF_T_GUARD, LWB_CONF_T_GUARD_1, LWB_CONF_T_GUARD_2, LWB_CONF_T_GUARD_3
+/* STATE:      BOOTSTRAP,        QUASI_SYNCED,      SYNCED,           SYNCED_2,         MISSED,             UNSYNCED,           UNSYNCED2,          RESYNC */
+/* T_GUARD: */ LWB_CONF_T_GUARD, LWB_CONF_T_GUARD,  LWB_CONF_T_GUARD, LWB_CONF_T_GUARD, LWB_CONF_T_GUARD_1, LWB_CONF_T_GUARD_2, LWB_CONF_T_GUARD_3, LWB_CONF_T_GUARD_3
 };
+#endif /* LWB_CONF_ADAPTIVE_GUARD */
 /*---------------------------------------------------------------------------*/
 #ifdef LWB_CONF_TASK_ACT_PIN
   #define LWB_TASK_RESUMED        PIN_SET(LWB_CONF_TASK_ACT_PIN)
@@ -153,7 +254,93 @@ static const uint32_t guard_time[NUM_OF_SYNC_STATES] = {
 /*---------------------------------------------------------------------------*/
 #define LWB_T_SLOT_START(i)       ((LWB_CONF_T_SCHED + LWB_CONF_T_GAP) + \
                                    (LWB_CONF_T_DATA + LWB_CONF_T_GAP) * i)
+/* worst-case clock deviation after skipping k rounds of length p */
+#define LWB_T_SKIP_DEV(k, p)      LWB_PERIOD_TO_TICKS((uint32_t)(p) * ((k) + 1),\
+                                              LWB_CONF_SKIP_RESIDUAL_DEV)
+/* time until the next round (in units of 1/LWB_CONF_PERIOD_SCALE s) */
+#define LWB_T_NEXT_ROUND          ((uint32_t)schedule.period * \
+                                   (1 + rounds_skipped))
+/* upper bound for the guard time of the schedule */
+#if LWB_CONF_RESYNC_ROUNDS
+#define LWB_T_GUARD_MAX           ((RESYNC == sync_state) ? \
+                                   LWB_CONF_RESYNC_T_GUARD_MAX : \
+                                   LWB_CONF_T_GUARD_MAX)
+#else /* LWB_CONF_RESYNC_ROUNDS */
+#define LWB_T_GUARD_MAX           LWB_CONF_T_GUARD_MAX
+#endif /* LWB_CONF_RESYNC_ROUNDS */
+#if LWB_CONF_BOOT_BEACON_INTERVAL
+/* length of a beacon (header-only schedule) */
+#define LWB_T_BEACON              LWB_T_SLOT_MIN(LWB_SCHED_PKT_HEADER_LEN)
+#define LWB_T_BEACON_INTERVAL     ((rtimer_clock_t)LWB_CONF_BOOT_BEACON_INTERVAL \
+                                   * RTIMER_SECOND_HF / 1000)
+/* min. distance between a beacon and a round, such that the beacons don't 
+ * end up in the schedule reception windows of the synced nodes */
+#define LWB_T_BEACON_MARGIN       (LWB_CONF_T_SCHED + \
+                                   LWB_CONF_RESYNC_T_GUARD_MAX + \
+                                   LWB_CONF_T_PREPROCESS * RTIMER_SECOND_HF / \
+                                   1000)
+/* a scan must cover one round or one beacon interval */
+#define LWB_T_SCAN                (MAX(LWB_CONF_T_SCHED2_START, \
+                                       LWB_T_BEACON_INTERVAL) + \
+                                   2 * LWB_CONF_T_SCHED)
+#else /* LWB_CONF_BOOT_BEACON_INTERVAL */
+/* a scan must cover one round (incl. the 2nd schedule) */
+#define LWB_T_SCAN                (LWB_CONF_T_SCHED2_START + \
+                                   2 * LWB_CONF_T_SCHED)
+#endif /* LWB_CONF_BOOT_BEACON_INTERVAL */
+/* max. sleep time between two scans (LF clock ticks): the last known period,
+ * or the idle period if none is known */
+#define LWB_T_SCAN_SLEEP_MAX(s)   LWB_PERIOD_TO_TICKS(((s)->period & 0x7fff) ? \
+                                              ((s)->period & 0x7fff) : \
+                                              LWB_CONF_SCHED_PERIOD_IDLE, \
+                                              RTIMER_SECOND_LF)
+/* guard time for the wake-up during bootstrap, t clock ticks ahead (the 
+ * clock drift is not compensated yet, assume 100 ppm) */
+#define LWB_T_BOOT_GUARD(t)       (LWB_CONF_T_GUARD_3 + (t) / 10000)
+/* offset of the j-th mini-slot within the contention slot */
+#define LWB_T_MINISLOT_START(j)   ((LWB_CONF_T_CONT + LWB_CONF_T_GAP) * (j))
+#if LWB_CONF_SCHED2_EARLY
+/* end of the last slot of the round with schedule s: 
+ * LWB_CONF_T_SCHED2_START minus the slots that are not used */
+#define LWB_T_SLOTS_END(s)        (LWB_CONF_T_SCHED2_START - \
+                                   (uint32_t)(LWB_CONF_MAX_DATA_SLOTS + 1 + \
+                                    LWB_CONF_DATA_ACK - \
+                                    LWB_SCHED_N_SLOTS(s) - \
+                                    LWB_SCHED_HAS_SACK_SLOT(s) - \
+                                    (LWB_CONF_DATA_ACK && \
+                                     LWB_SCHED_HAS_DACK_SLOT(s))) * \
+                                   (LWB_CONF_T_DATA + LWB_CONF_T_GAP) - \
+                                   (LWB_SCHED_HAS_CONT_SLOT(s) ? 0 : \
+                                    LWB_T_MINISLOT_START( \
+                                      LWB_CONF_CONT_N_MINISLOTS)))
+/* start of the 2nd schedule: after the last slot plus the margin for the 
+ * schedule computation, at most LWB_CONF_T_SCHED2_START */
+#define LWB_T_SCHED2_START(s)     ((LWB_T_SLOTS_END(s) + \
+                                    LWB_CONF_T_SCHED2_MARGIN < \
+                                    LWB_CONF_T_SCHED2_START) ? \
+                                   (LWB_T_SLOTS_END(s) + \
+                                    LWB_CONF_T_SCHED2_MARGIN) : \
+                                   LWB_CONF_T_SCHED2_START)
+/* earliest possible start of the 2nd schedule (round without any slots) */
+#define LWB_T_SCHED2_MIN          ((LWB_CONF_T_SCHED + LWB_CONF_T_GAP + \
+                                    LWB_CONF_T_SCHED2_MARGIN + \
+                                    LWB_CONF_T_SCHED2_START - \
+                                    LWB_T_ROUND_MAX < \
+                                    LWB_CONF_T_SCHED2_START) ? \
+                                   (LWB_CONF_T_SCHED + LWB_CONF_T_GAP + \
+                                    LWB_CONF_T_SCHED2_MARGIN + \
+                                    LWB_CONF_T_SCHED2_START - \
+                                    LWB_T_ROUND_MAX) : \
+                                   LWB_CONF_T_SCHED2_START)
+#else /* LWB_CONF_SCHED2_EARLY */
+#define LWB_T_SCHED2_START(s)     LWB_CONF_T_SCHED2_START
+#define LWB_T_SCHED2_MIN          LWB_CONF_T_SCHED2_START
+#endif /* LWB_CONF_SCHED2_EARLY */
 #define LWB_DATA_RCVD             (glossy_get_n_rx() > 0)
+/* energy / preamble detected in the contention slot, but no valid packet */
+#define LWB_COLLISION_DETECTED    (glossy_get_n_rx() == 0 && \
+                                   (glossy_get_n_rx_started() > 0 || \
+                                    glossy_get_n_header_fail() > 0))
 #define RTIMER_CAPTURE            (t_now = rtimer_now_hf())
 #define RTIMER_ELAPSED            ((rtimer_now_hf() - t_now) * 1000 / 3250)    
 #define GET_EVENT                 (glossy_is_t_ref_updated() ? \
@@ -168,25 +355,36 @@ static const uint32_t guard_time[NUM_OF_SYNC_STATES] = {
   LWB_WAIT_UNTIL(rt->time + LWB_CONF_T_SCHED);\
   glossy_stop();\
 }   
-#define LWB_RCV_SCHED() \
+#define LWB_SEND_BEACON() \
+{\
+  glossy_start(node_id, glossy_payload.raw_data, LWB_SCHED_PKT_HEADER_LEN, \
+               LWB_CONF_TX_CNT_SCHED, GLOSSY_WITH_SYNC, GLOSSY_WITH_RF_CAL);\
+  LWB_WAIT_UNTIL(rt->time + LWB_T_BEACON);\
+  glossy_stop();\
+}
+#define LWB_RCV_SCHED()           LWB_RCV_SCHED_WINDOW(0)
+/* receive a schedule that starts within the next 'w' clock ticks */
+#define LWB_RCV_SCHED_WINDOW(w) \
 {\
   glossy_start(GLOSSY_UNKNOWN_INITIATOR, (uint8_t *)&schedule, \
                GLOSSY_UNKNOWN_PAYLOAD_LEN, \
                LWB_CONF_TX_CNT_SCHED, GLOSSY_WITH_SYNC, GLOSSY_WITH_RF_CAL);\
-  LWB_WAIT_UNTIL(rt->time + LWB_CONF_T_SCHED + t_guard);\
+  LWB_WAIT_UNTIL(rt->time + LWB_CONF_T_SCHED + t_guard + (w));\
   glossy_stop();\
 }   
-#define LWB_SEND_PACKET() \
+#define LWB_SEND_PACKET()         LWB_SEND_PACKET_FROM((uint8_t*)&glossy_payload)
+#define LWB_SEND_PACKET_FROM(buf) \
 {\
-  glossy_start(node_id, (uint8_t*)&glossy_payload, payload_len, \
+  glossy_start(node_id, buf, payload_len, \
                LWB_CONF_TX_CNT_DATA, GLOSSY_WITHOUT_SYNC, \
                GLOSSY_WITHOUT_RF_CAL);\
   LWB_WAIT_UNTIL(rt->time + LWB_CONF_T_DATA);\
   glossy_stop();\
 }
-#define LWB_RCV_PACKET() \
+#define LWB_RCV_PACKET()          LWB_RCV_PACKET_INTO((uint8_t*)&glossy_payload)
+#define LWB_RCV_PACKET_INTO(buf) \
 {\
-  glossy_start(GLOSSY_UNKNOWN_INITIATOR, (uint8_t*)&glossy_payload, \
+  glossy_start(GLOSSY_UNKNOWN_INITIATOR, buf, \
                GLOSSY_UNKNOWN_PAYLOAD_LEN, \
                LWB_CONF_TX_CNT_DATA, GLOSSY_WITHOUT_SYNC, \
                GLOSSY_WITHOUT_RF_CAL);\
@@ -228,12 +426,21 @@ static const uint32_t guard_time[NUM_OF_SYNC_STATES] = {
   LWB_TASK_RESUMED;\
   LWB_AFTER_DEEPSLEEP();\
 }
+#if LWB_CONF_ADAPTIVE_GUARD
+/* the guard time is computed separately (see lwb_guard_time) */
+#define LWB_UPDATE_SYNC_STATE \
+{\
+  /* get the new state based on the event */\
+  sync_state = next_state[GET_EVENT][sync_state];\
+}
+#else /* LWB_CONF_ADAPTIVE_GUARD */
 #define LWB_UPDATE_SYNC_STATE \
 {\
   /* get the new state based on the event */\
   sync_state = next_state[GET_EVENT][sync_state];\
   t_guard = guard_time[sync_state];         /* adjust the guard time */\
 }
+#endif /* LWB_CONF_ADAPTIVE_GUARD */
 #ifndef LWB_BEFORE_DEEPSLEEP
 #define LWB_BEFORE_DEEPSLEEP() 
 #endif /* LWB_PREPARE_DEEPSLEEP */
@@ -244,25 +451,119 @@ static const uint32_t guard_time[NUM_OF_SYNC_STATES] = {
 static struct pt        lwb_pt;
 static void*            pre_proc;
 static struct process*  post_proc;
+#if LWB_RX_NOTIFY
+static struct process*  rx_proc = 0;
+#endif /* LWB_RX_NOTIFY */
 static lwb_sync_state_t sync_state;
 static rtimer_clock_t   reception_timestamp;
 static uint32_t         global_time;
+/* network time reference: the network time (in us) at the start of the last
+ * round, the corresponding local timestamp (LF ticks if the LF clock is used
+ * for the wake-up, HF ticks otherwise) and the length of a local clock tick 
+ * in us (drift compensated, fixed point with LWB_TIME_FP fractional bits) */
+static uint64_t         time_ref_us;
+static rtimer_clock_t   time_ref_ticks;
+static uint32_t         time_tick_us = 0;
+#define LWB_LF_CALIB      (LWB_CONF_USE_LF_FOR_WAKEUP && LWB_CONF_LF_CALIB)
+#if LWB_LF_CALIB
+/* measured ratio between the HF and the LF clock (fixed point, 16 fractional
+ * bits) and the HF/LF timestamps of the last LF clock edge used as anchor */
+static uint32_t         hf_lf_ratio = ((uint64_t)RTIMER_SECOND_HF << 16) /
+                                      RTIMER_SECOND_LF;
+static rtimer_clock_t   calib_hf, calib_lf;
+static uint8_t          calib_valid = 0;
+#define LWB_HF_TO_LF(t)   (((uint64_t)(t) << 16) / hf_lf_ratio)
+#define LWB_LF_SETTLE     LWB_CONF_LF_SETTLE
+#else /* LWB_LF_CALIB */
+#define LWB_HF_TO_LF(t)   ((t) / RTIMER_HF_LF_RATIO)
+#define LWB_LF_SETTLE     0
+#endif /* LWB_LF_CALIB */
 static lwb_statistics_t stats = { 0 };
-static uint8_t          urgent_stream_req = 0;
+#if LWB_CONF_SYNC_STATS
+/* sync quality of one round (source node) */
+typedef struct {
+  int16_t  ofs;           /* actual - expected start of the round, in us */
+  uint16_t guard;         /* guard time used for the 1st schedule, in us */
+  int16_t  drift;         /* clock drift estimate, in ppm */
+  uint8_t  relay_cnt;     /* relay count of the first RX */
+  int8_t   snr;
+  uint8_t  sched;         /* schedule that synced the round (1st, 2nd, 0) */
+  uint8_t  anomaly;
+} lwb_sync_rec_t;
+static lwb_sync_rec_t   sync_rec[LWB_CONF_SYNC_STATS];
+static uint8_t          sync_rec_idx = 0, sync_rec_cnt = 0;
+#endif /* LWB_CONF_SYNC_STATS */
+#if LWB_CONF_CHECKPOINT
+/* checkpoint of a source node: sync state and stream table (the host uses
+ * the same memory block for the checkpoint of the scheduler) */
+typedef struct {
+  uint16_t crc;
+  uint16_t period;
+  uint32_t time;          /* time of the last received schedule */
+  int32_t  drift_est;
+  uint32_t drift_var;
+  int32_t  drift_last;
+  uint8_t  streams[LWB_STREAM_TABLE_SIZE];
+} lwb_checkpoint_t;
+static uint32_t         ckpt_addr = XMEM_ALLOC_ERROR;
+static uint8_t          ckpt_cnt = 0;      /* # rounds since last checkpoint */
+#endif /* LWB_CONF_CHECKPOINT */
+#if LWB_CONF_STANDBY_HOST_ID
+#define LWB_IS_STANDBY_HOST     (node_id == LWB_CONF_STANDBY_HOST_ID)
+/* set when the standby host takes over: time and period of its 1st round */
+static uint8_t          standby_active = 0;
+static uint32_t         standby_time;
+static uint16_t         standby_period;
+/* source thread only: listen (but don't send) in the slots of the last 
+ * schedule while the schedule is missed, and note any received flood */
+#define LWB_STANDBY_LISTEN_ONLY (LWB_IS_STANDBY_HOST && standby_missed && \
+                                 sync_state != SYNCED && \
+                                 sync_state != UNSYNCED)
+#define LWB_STANDBY_RX_CHECK    if(LWB_DATA_RCVD) { standby_heard = 1; }
+#else /* LWB_CONF_STANDBY_HOST_ID */
+#define LWB_STANDBY_LISTEN_ONLY 0
+#define LWB_STANDBY_RX_CHECK
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+static uint8_t          urgent_stream_req = LWB_INVALID_STREAM_ID;
 /* no buffers needed if this is only a relay node */
 #if !LWB_CONF_RELAY_ONLY
 #if !LWB_CONF_USE_XMEM
-/* allocate memory in the SRAM (+1 to store the message length) */
-static uint8_t          in_buffer_mem[LWB_CONF_IN_BUFFER_SIZE * 
-                                      (LWB_CONF_MAX_DATA_PKT_LEN + 1)];  
-static uint8_t          out_buffer_mem[LWB_CONF_OUT_BUFFER_SIZE * 
-                                       (LWB_CONF_MAX_DATA_PKT_LEN + 1)]; 
+/* allocate memory in the SRAM (messages are stored with their length) */
+static uint8_t          in_buffer_mem[LWB_CONF_IN_BUFFER_BYTES];
+static uint8_t          out_buffer_mem[LWB_OUT_QUEUE_BYTES * 
+                                       LWB_CONF_OUT_N_QUEUES]; 
 #else /* LWB_CONF_USE_XMEM */
 static uint8_t          data_buffer[LWB_CONF_MAX_DATA_PKT_LEN + 1];
+/* messages are composed in a separate buffer (lwb_reserve_data), the data 
+ * buffer may be used by lwb_peek_data before the message is committed */
+static uint8_t          compose_buffer[LWB_CONF_MAX_DATA_PKT_LEN + 1];
 static uint32_t         stats_addr = 0;
 #endif /* LWB_CONF_USE_XMEM */
-FIFO(in_buffer, LWB_CONF_MAX_DATA_PKT_LEN + 1, LWB_CONF_IN_BUFFER_SIZE);
-FIFO(out_buffer, LWB_CONF_MAX_DATA_PKT_LEN + 1, LWB_CONF_OUT_BUFFER_SIZE);
+BFIFO(in_buffer, LWB_CONF_IN_BUFFER_BYTES);
+/* the outgoing queues (one or several, selected by the stream ID) */
+static struct bfifo     out_buffer[LWB_CONF_OUT_N_QUEUES];
+static struct bfifo*    out_resv_q = out_buffer; /* queue of reserved block */
+static uint8_t          out_resv_open = 0;  /* reservation not committed yet */
+static struct bfifo*    out_get_q = 0;           /* queue of msg being sent */
+static uint8_t          out_get_n = 0;    /* number of messages being sent */
+/* number of messages that have been sent but not yet removed from each 
+ * queue and the offset of the next message to send */
+static uint8_t          out_sent[LWB_CONF_OUT_N_QUEUES];
+static uint16_t         out_sent_ofs[LWB_CONF_OUT_N_QUEUES];
+#if LWB_CONF_DATA_ACK
+/* queue (index + 1) of the message sent in each data slot of the last round
+ * in which this node sent data, kept until the D-ACK has been received */
+static uint8_t          out_sent_slot[LWB_CONF_MAX_DATA_SLOTS];
+#if LWB_CONF_AGGREGATE
+static uint8_t          out_sent_cnt[LWB_CONF_MAX_DATA_SLOTS];  /* # msgs */
+#endif /* LWB_CONF_AGGREGATE */
+static uint8_t          out_sent_n_slots;
+static uint16_t         out_sent_time;
+#endif /* LWB_CONF_DATA_ACK */
+#if LWB_CONF_OUT_N_QUEUES > 1
+/* time at which the next message of each queue is due */
+static uint32_t         out_due[LWB_CONF_OUT_N_QUEUES];
+#endif /* LWB_CONF_OUT_N_QUEUES */
 #endif /* LWB_CONF_RELAY_ONLY */
 /*---------------------------------------------------------------------------*/
 uint8_t
@@ -314,6 +615,21 @@ lwb_stats_reset(void)
 }
 /*---------------------------------------------------------------------------*/
 #if !LWB_CONF_RELAY_ONLY
+/* returns the buffer to receive the next data packet into: a block in the 
+ * incoming queue if possible, the fallback buffer otherwise */
+static inline uint8_t*
+lwb_in_buffer_reserve(uint8_t* fallback)
+{
+#if LWB_RX_ZERO_COPY
+  /* reserve enough space for a packet of max. length (+1 for the length) */
+  uint32_t pkt_addr = bfifo_reserve(&in_buffer, LWB_CONF_MAX_PKT_LEN + 1);
+  if(BFIFO_ERROR != pkt_addr) {
+    return (uint8_t*)(uint16_t)pkt_addr + 1;
+  }
+#endif /* LWB_RX_ZERO_COPY */
+  return fallback;
+}
+/*---------------------------------------------------------------------------*/
 /* store a received message in the incoming queue, returns 1 if successful, 
  * 0 otherwise */
 uint8_t 
@@ -323,168 +639,892 @@ lwb_in_buffer_put(const uint8_t * const data, uint8_t len)
     len = LWB_CONF_MAX_DATA_PKT_LEN;
     DEBUG_PRINT_WARNING("received data packet is too big"); 
   }
-  /* received messages will have the max. length LWB_CONF_MAX_DATA_PKT_LEN */
-  uint32_t pkt_addr = fifo_put(&in_buffer);
-  if(FIFO_ERROR != pkt_addr) {
+#if LWB_RX_ZERO_COPY
+  if(data == (uint8_t*)(uint16_t)BFIFO_RESV_ADDR(&in_buffer) + 1) {
+    /* the message has been received directly into the queue: commit it */
+    *((uint8_t*)data - 1) = len;
+    bfifo_put(&in_buffer, len + 1);
+    return 1;
+  }
+#endif /* LWB_RX_ZERO_COPY */
+  /* each message is preceded by its length */
+  uint32_t pkt_addr = bfifo_reserve(&in_buffer, len + 1);
+  if(BFIFO_ERROR != pkt_addr) {
 #if !LWB_CONF_USE_XMEM
     /* copy the data into the queue */
-    memcpy((uint8_t*)(uint16_t)pkt_addr, data, len);
-    /* last byte holds the payload length */
-    *(uint8_t*)((uint16_t)pkt_addr + LWB_CONF_MAX_DATA_PKT_LEN) = len;    
+    *(uint8_t*)(uint16_t)pkt_addr = len;
+    memcpy((uint8_t*)(uint16_t)pkt_addr + 1, data, len);
 #else /* LWB_CONF_USE_XMEM */
     /* write the data into the queue in the external memory */
-    xmem_write(pkt_addr, len, data);
-    xmem_write(pkt_addr + LWB_CONF_MAX_DATA_PKT_LEN, 1, &len);
+    xmem_write(pkt_addr, 1, &len);
+    xmem_write(pkt_addr + 1, len, data);
 #endif /* LWB_CONF_USE_XMEM */
+    bfifo_put(&in_buffer, len + 1);
     return 1;
   }
   DEBUG_PRINT_VERBOSE("in queue full");
   return 0;
 }
 /*---------------------------------------------------------------------------*/
-/* fetch the next 'ready-to-send' message from the outgoing queue
- * returns the message length in bytes */
-uint8_t 
-lwb_out_buffer_get(uint8_t* out_data)
-{   
-  /* messages have the max. length LWB_CONF_MAX_DATA_PKT_LEN and are already
-   * formatted according to glossy_payload_t */
-  uint32_t pkt_addr = fifo_get(&out_buffer);
-  if(FIFO_ERROR != pkt_addr) {
-#if !LWB_CONF_USE_XMEM
-    /* assume pointers are always 16-bit */
-    uint8_t* next_msg = (uint8_t*)(uint16_t)pkt_addr;
-    /* check the length */
-    uint8_t len = *(next_msg + LWB_CONF_MAX_DATA_PKT_LEN);
-    if(len > LWB_CONF_MAX_DATA_PKT_LEN) {
-      DEBUG_PRINT_WARNING("invalid message length detected");
-      len = LWB_CONF_MAX_DATA_PKT_LEN;  /* truncate */
+#if LWB_CONF_AGGREGATE
+/* stores the messages of a received data packet in the incoming queue (an 
+ * aggregated packet is split into its messages), tmp is used to unpack a 
+ * packet that has been received directly into the queue; returns the number
+ * of stored messages */
+static uint8_t
+lwb_in_buffer_put_pkt(uint8_t* pkt, uint8_t len, uint8_t* tmp)
+{
+  uint8_t ofs, msg_len, cnt = 0;
+  if(!LWB_PKT_IS_AGGR(pkt)) {
+    return lwb_in_buffer_put(pkt, len);
+  }
+#if LWB_RX_ZERO_COPY
+  if(pkt == (uint8_t*)(uint16_t)BFIFO_RESV_ADDR(&in_buffer) + 1) {
+    memcpy(tmp, pkt, len);     /* the reserved block is not committed */
+    pkt = tmp;
+  }
+#endif /* LWB_RX_ZERO_COPY */
+  if(len > LWB_CONF_MAX_DATA_PKT_LEN) {
+    len = LWB_CONF_MAX_DATA_PKT_LEN;
+  }
+  ofs = LWB_DATA_PKT_HEADER_LEN;
+  while(ofs + LWB_AGGR_SUBHDR_LEN <= len) {
+    msg_len = pkt[ofs];
+    if(ofs + LWB_AGGR_SUBHDR_LEN + msg_len > len) {
+      DEBUG_PRINT_WARNING("invalid aggregated packet");
+      break;
     }
-    memcpy(out_data, next_msg, len);
+#if LWB_VERSION == 1
+    /* restore the header in front of the payload (overwrites the preceding
+     * sub-header and the last byte of the previous message) */
+    pkt[ofs] = pkt[1];
+    pkt[ofs - 1] = pkt[0];
+    cnt += lwb_in_buffer_put(pkt + ofs - 1, msg_len + LWB_DATA_PKT_HEADER_LEN);
+#else /* LWB_VERSION */
+    cnt += lwb_in_buffer_put(pkt + ofs + 1, msg_len);
+#endif /* LWB_VERSION */
+    ofs += LWB_AGGR_SUBHDR_LEN + msg_len;
+  }
+  return cnt;
+}
+#else /* LWB_CONF_AGGREGATE */
+#define lwb_in_buffer_put_pkt(pkt, len, tmp)  lwb_in_buffer_put(pkt, len)
+#endif /* LWB_CONF_AGGREGATE */
+/*---------------------------------------------------------------------------*/
+/* returns the length of the message stored at pkt_addr */
+static inline uint8_t
+lwb_buffer_read_len(uint32_t pkt_addr)
+{
+  uint8_t len;
+#if !LWB_CONF_USE_XMEM
+  len = *(uint8_t*)(uint16_t)pkt_addr;
+#else /* LWB_CONF_USE_XMEM */
+  xmem_read(pkt_addr, 1, &len);
+#endif /* LWB_CONF_USE_XMEM */
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+#if LWB_CONF_AGGREGATE
+/* copies len bytes from the queue memory at addr into dst */
+static inline void
+lwb_buffer_read(uint32_t addr, uint8_t len, uint8_t* dst)
+{
+#if !LWB_CONF_USE_XMEM
+  memcpy(dst, (uint8_t*)(uint16_t)addr, len);
+#else /* LWB_CONF_USE_XMEM */
+  xmem_read(addr, len, dst);
+#endif /* LWB_CONF_USE_XMEM */
+}
+#endif /* LWB_CONF_AGGREGATE */
+/*---------------------------------------------------------------------------*/
+/* returns the length of the oldest message in the queue */
+static inline uint8_t
+lwb_buffer_peek_len(struct bfifo * const q)
+{
+  uint32_t pkt_addr = bfifo_peek(q);
+  if(BFIFO_ERROR != pkt_addr) {
+    return lwb_buffer_read_len(pkt_addr);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+lwb_out_buffer_init(void)
+{
+  uint8_t k;
+#if LWB_CONF_USE_XMEM
+  uint32_t start = xmem_alloc(LWB_OUT_QUEUE_BYTES * LWB_CONF_OUT_N_QUEUES);
 #else /* LWB_CONF_USE_XMEM */
-    xmem_read(pkt_addr, LWB_CONF_MAX_DATA_PKT_LEN + 1, data_buffer);
+  uint32_t start = (uint16_t)out_buffer_mem;
+#endif /* LWB_CONF_USE_XMEM */
+  for(k = 0; k < LWB_CONF_OUT_N_QUEUES; k++) {
+    out_buffer[k].size = LWB_OUT_QUEUE_BYTES;
+    bfifo_init(&out_buffer[k], start + (uint16_t)k * LWB_OUT_QUEUE_BYTES);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* selects the outgoing queue to serve in the current data slot, returns 0 
+ * if there are no messages left to send */
+static inline struct bfifo*
+lwb_out_buffer_select(void)
+{
+#if LWB_CONF_OUT_N_QUEUES > 1
+  /* the scheduler assigns the slots according to the IPIs of the streams:
+   * take the non-empty queue that is due first (earliest deadline) */
+  uint8_t k, q = 0xff;
+  for(k = 0; k < LWB_CONF_OUT_N_QUEUES; k++) {
+    if(out_buffer[k].count > out_sent[k] && 
+       (q == 0xff || (int32_t)(out_due[k] - out_due[q]) < 0)) {
+      q = k;
+    }
+  }
+  return (q == 0xff) ? 0 : &out_buffer[q];
+#else /* LWB_CONF_OUT_N_QUEUES */
+  return (out_buffer->count > out_sent[0]) ? out_buffer : 0;
+#endif /* LWB_CONF_OUT_N_QUEUES */
+}
+/*---------------------------------------------------------------------------*/
+/* returns the address of the next message to send in the k-th queue */
+static inline uint32_t
+lwb_out_buffer_next(uint8_t k)
+{
+  /* the messages in front of this one have already been sent */
+  uint16_t ofs = out_sent[k] ? out_sent_ofs[k] : out_buffer[k].read;
+  if(ofs >= out_buffer[k].end) {
+    ofs = 0;                                     /* wrap around */
+  }
+  return out_buffer[k].start + ofs;
+}
+/*---------------------------------------------------------------------------*/
+/* marks the message at pkt_addr (stored length len) in the k-th queue as 
+ * sent */
+static inline void
+lwb_out_buffer_advance(uint8_t k, uint32_t pkt_addr, uint8_t len)
+{
+  out_sent_ofs[k] = pkt_addr - out_buffer[k].start + len + 1;
+  if(out_sent_ofs[k] >= out_buffer[k].end) {
+    out_sent_ofs[k] = 0;
+  }
+  out_sent[k]++;
+}
+/*---------------------------------------------------------------------------*/
+#if LWB_CONF_AGGREGATE
+/* appends the next messages of the k-th queue for the same recipient to the
+ * message msg (length len) as long as they fit into one data packet, the 
+ * packet is composed in buf (msg may point to buf); returns the packet 
+ * length or 0 if there is nothing to aggregate */
+static uint8_t
+lwb_out_buffer_aggregate(uint8_t k, const uint8_t* msg, uint8_t len, 
+                         uint8_t* buf)
+{
+  uint8_t  hdr[LWB_DATA_PKT_HEADER_LEN + 1];         /* length and header */
+  uint8_t  msg_len, pkt_len = 0;
+  uint32_t pkt_addr;
+#if LWB_VERSION == 2
+  /* all packets have the aggregated format: the first message is preceded
+   * by its length */
+  memmove(buf + 1, msg, len);
+  buf[0] = len;
+  pkt_len = len + 1;
+#endif /* LWB_VERSION */
+  while(out_buffer[k].count > out_sent[k]) {
+    pkt_addr = lwb_out_buffer_next(k);
+    lwb_buffer_read(pkt_addr, LWB_DATA_PKT_HEADER_LEN + 1, hdr);
+    msg_len = hdr[0] - LWB_DATA_PKT_HEADER_LEN;      /* payload length */
+    if((uint16_t)(pkt_len ? pkt_len : (len + LWB_AGGR_SUBHDR_LEN)) + 
+       msg_len + LWB_AGGR_SUBHDR_LEN > LWB_CONF_MAX_DATA_PKT_LEN) {
+      break;                                /* the message doesn't fit */
+    }
+#if LWB_VERSION == 1
+    if(LWB_PKT_RECIPIENT(hdr + 1) != LWB_PKT_RECIPIENT(msg)) {
+      break;                                /* other recipient */
+    }
+    if(!pkt_len) {
+      /* convert the first message: header, sub-header, payload */
+      uint8_t stream_id = LWB_PKT_STREAM_ID(msg);
+      uint16_t recipient = LWB_PKT_RECIPIENT(msg);
+      memmove(buf + LWB_DATA_PKT_HEADER_LEN + LWB_AGGR_SUBHDR_LEN, 
+              msg + LWB_DATA_PKT_HEADER_LEN, len - LWB_DATA_PKT_HEADER_LEN);
+      LWB_PKT_SET_RECIPIENT(buf, recipient);
+      LWB_PKT_STREAM_ID(buf) = LWB_AGGR_STREAM_ID;
+      buf[LWB_DATA_PKT_HEADER_LEN] = len - LWB_DATA_PKT_HEADER_LEN;
+      buf[LWB_DATA_PKT_HEADER_LEN + 1] = stream_id;
+      pkt_len = len + LWB_AGGR_SUBHDR_LEN;
+    }
+    buf[pkt_len + 1] = LWB_PKT_STREAM_ID(hdr + 1);
+#endif /* LWB_VERSION */
+    buf[pkt_len] = msg_len;
+    lwb_buffer_read(pkt_addr + LWB_DATA_PKT_HEADER_LEN + 1, msg_len, 
+                    buf + pkt_len + LWB_AGGR_SUBHDR_LEN);
+    pkt_len += msg_len + LWB_AGGR_SUBHDR_LEN;
+    lwb_out_buffer_advance(k, pkt_addr, hdr[0]);
+    out_get_n++;
+  }
+  return pkt_len;
+}
+#endif /* LWB_CONF_AGGREGATE */
+/*---------------------------------------------------------------------------*/
+/* fetch the next 'ready-to-send' message from the outgoing queue(s), returns
+ * a pointer to the message and the message length in bytes; the message is 
+ * sent directly from the queue if possible, in this case a pointer into the 
+ * queue is returned (instead of buf); the message remains in the queue until
+ * it is removed with lwb_out_buffer_release() */
+static uint8_t*
+lwb_out_buffer_get(uint8_t* buf, uint8_t * const out_len)
+{   
+  /* messages are already formatted according to glossy_payload_t */
+  uint8_t len, idx;
+  *out_len = 0;
+  out_get_q = lwb_out_buffer_select();
+  if(out_get_q) {
+    idx = out_get_q - out_buffer;
+    uint32_t pkt_addr = lwb_out_buffer_next(idx);
+    len = lwb_buffer_read_len(pkt_addr);
+    lwb_out_buffer_advance(idx, pkt_addr, len);
+    out_get_n = 1;
     /* check the length */
-    uint8_t len = *(out_data + LWB_CONF_MAX_DATA_PKT_LEN);
     if(len > LWB_CONF_MAX_DATA_PKT_LEN) {
       DEBUG_PRINT_WARNING("invalid message length detected");
       len = LWB_CONF_MAX_DATA_PKT_LEN;  /* truncate */
     }
-    memcpy(out_data, data_buffer, len);
+#if !LWB_CONF_USE_XMEM
+    /* assume pointers are always 16-bit */
+    uint8_t* msg = (uint8_t*)(uint16_t)pkt_addr + 1;
+#else /* LWB_CONF_USE_XMEM */
+    uint8_t* msg = buf;
+    xmem_read(pkt_addr + 1, len, buf);
 #endif /* LWB_CONF_USE_XMEM */
-    return len;
+#if LWB_CONF_OUT_N_QUEUES > 1
+    /* the next message of this stream is due one IPI later; a stream that
+     * lags behind (or has no IPI) is due now */
+    uint32_t* due = &out_due[idx];
+    uint16_t ipi = lwb_stream_get_ipi(LWB_PKT_STREAM_ID(msg));
+    if((int32_t)(*due + ipi - global_time) > 0) {
+      *due += ipi;
+    } else {
+      *due = global_time;
+    }
+#endif /* LWB_CONF_OUT_N_QUEUES */
+#if LWB_CONF_AGGREGATE
+    uint8_t pkt_len = lwb_out_buffer_aggregate(idx, msg, len, buf);
+    if(pkt_len) {
+      DEBUG_PRINT_VERBOSE("%u messages aggregated", out_get_n);
+      msg = buf;
+      len = pkt_len;
+    }
+#endif /* LWB_CONF_AGGREGATE */
+    *out_len = len;
+    return msg;
   }
   DEBUG_PRINT_VERBOSE("out queue empty");
+  return buf;
+}
+/*---------------------------------------------------------------------------*/
+/* removes the n oldest sent messages from the k-th outgoing queue */
+static void
+lwb_out_buffer_drop(uint8_t k, uint8_t n)
+{
+  while(n-- && out_sent[k]) {
+    bfifo_drop(&out_buffer[k], lwb_buffer_peek_len(&out_buffer[k]) + 1);
+    out_sent[k]--;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* removes the message(s) obtained with lwb_out_buffer_get() from the 
+ * outgoing queue (call this function once the packet has been sent) */
+static inline void
+lwb_out_buffer_release(void)
+{
+  if(out_get_q) {
+    lwb_out_buffer_drop(out_get_q - out_buffer, out_get_n);
+    out_get_q = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if LWB_CONF_DATA_ACK
+/* the message obtained with lwb_out_buffer_get() has been sent in data slot
+ * 'slot', keep it in the queue until it has been acknowledged */
+static inline void
+lwb_out_buffer_sent(uint8_t slot)
+{
+  if(out_get_q) {
+    out_sent_slot[slot] = out_get_q - out_buffer + 1;
+#if LWB_CONF_AGGREGATE
+    out_sent_cnt[slot] = out_get_n;
+#endif /* LWB_CONF_AGGREGATE */
+    out_get_q = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* processes the D-ACK for the messages sent in the last round: acknowledged 
+ * messages are removed from the queues, the first unacknowledged message of 
+ * a queue and all messages sent after it will be retransmitted (go-back-N);
+ * pass 0 if no D-ACK has been received */
+static void
+lwb_out_buffer_dack(const uint8_t * const bitmap)
+{
+  uint8_t i, k;
+  for(k = 0; k < LWB_CONF_OUT_N_QUEUES; k++) {
+    for(i = 0; i < out_sent_n_slots; i++) {
+      if(out_sent_slot[i] == k + 1) {
+        if(!bitmap || !(bitmap[i >> 3] & (1 << (i & 7)))) {
+          DEBUG_PRINT_VERBOSE("%u message(s) not acknowledged", out_sent[k]);
+          break;
+        }
+#if LWB_CONF_AGGREGATE
+        lwb_out_buffer_drop(k, out_sent_cnt[i]);
+#else /* LWB_CONF_AGGREGATE */
+        lwb_out_buffer_drop(k, 1);
+#endif /* LWB_CONF_AGGREGATE */
+      }
+    }
+    out_sent[k] = 0;  /* send the remaining messages again */
+  }
+  out_sent_n_slots = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* returns 1 if messages have been sent that are not yet acknowledged */
+static uint8_t
+lwb_out_buffer_dack_pending(void)
+{
+  uint8_t k;
+  for(k = 0; k < LWB_CONF_OUT_N_QUEUES; k++) {
+    if(out_sent[k]) {
+      return 1;
+    }
+  }
   return 0;
 }
+#endif /* LWB_CONF_DATA_ACK */
+/*---------------------------------------------------------------------------*/
+/* returns a pointer to the payload of a free block in the outgoing queue, 
+ * the header is already filled in */
+#if LWB_VERSION == 2
+uint8_t*
+lwb_reserve_data(void)
+{
+  if(out_resv_open) {
+    DEBUG_PRINT_VERBOSE("reservation pending");
+    return 0;
+  }
+#else /* LWB_VERSION */
+uint8_t*
+lwb_reserve_data(uint16_t recipient, uint8_t stream_id)
+{
+  /* only one reservation at a time (there is only one compose buffer) */
+  if(out_resv_open) {
+    DEBUG_PRINT_VERBOSE("reservation pending");
+    return 0;
+  }
+  if(LWB_STREAM_ID_RESERVED(stream_id)) {
+    return 0;
+  }
+  out_resv_q = LWB_OUT_QUEUE(stream_id);
+#endif /* LWB_VERSION */
+#if !LWB_CONF_USE_XMEM
+  /* reserve enough space for a message of max. length (+1 for the length) */
+  uint32_t pkt_addr;
+  LWB_QUEUE_ATOMIC(pkt_addr = bfifo_reserve(out_resv_q, 
+                                            LWB_CONF_MAX_DATA_PKT_LEN + 1));
+  if(BFIFO_ERROR == pkt_addr) {
+    DEBUG_PRINT_VERBOSE("out queue full");
+    return 0;
+  }
+  /* assume pointers are 16-bit */
+  uint8_t* next_msg = (uint8_t*)(uint16_t)pkt_addr + 1;  
+#else /* LWB_CONF_USE_XMEM */
+  /* compose the message in the compose buffer, it is written to the ext. 
+   * memory in lwb_commit_data() */
+  uint8_t* next_msg = compose_buffer + 1;
+#endif /* LWB_CONF_USE_XMEM */
+#if LWB_VERSION == 1
+  *(next_msg) = (uint8_t)recipient;   /* recipient L */  
+  *(next_msg + 1) = recipient >> 8;   /* recipient H */  
+  *(next_msg + 2) = stream_id; 
+#endif /* LWB_VERSION */
+  out_resv_open = 1;
+  return next_msg + LWB_DATA_PKT_HEADER_LEN;
+}
+/*---------------------------------------------------------------------------*/
+/* inserts the message composed in the reserved block into the outgoing 
+ * queue, returns 1 if successful, 0 otherwise */
+uint8_t
+lwb_commit_data(uint8_t len)
+{
+  if(!out_resv_open) {
+    return 0;
+  }
+  out_resv_open = 0;                /* released in any case */
+  if(len > LWB_DATA_PKT_PAYLOAD_LEN) {
+    return 0;
+  }
+  len += LWB_DATA_PKT_HEADER_LEN;
+#if !LWB_CONF_USE_XMEM
+  *(uint8_t*)(uint16_t)BFIFO_RESV_ADDR(out_resv_q) = len;
+#else /* LWB_CONF_USE_XMEM */
+  *compose_buffer = len;
+  uint32_t pkt_addr;
+  LWB_QUEUE_ATOMIC(pkt_addr = bfifo_reserve(out_resv_q, len + 1));
+  if(BFIFO_ERROR == pkt_addr) {
+    DEBUG_PRINT_VERBOSE("out queue full");
+    return 0;
+  }
+  xmem_write(pkt_addr, len + 1, compose_buffer);
+#endif /* LWB_CONF_USE_XMEM */
+  LWB_QUEUE_ATOMIC(bfifo_put(out_resv_q, len + 1));
+  return 1;
+}
 /*---------------------------------------------------------------------------*/
 /* puts a message into the outgoing queue, returns 1 if successful, 
  * 0 otherwise */
+#if LWB_VERSION == 2
+uint8_t
+lwb_put_data(const uint8_t * const data, uint8_t len)
+#else /* LWB_VERSION */
 uint8_t
 lwb_put_data(uint16_t recipient, 
              uint8_t stream_id, 
              const uint8_t * const data, 
              uint8_t len)
+#endif /* LWB_VERSION */
 {
   /* data has the max. length LWB_DATA_PKT_PAYLOAD_LEN, lwb header needs 
    * to be added before the data is inserted into the queue */
   if(len > LWB_DATA_PKT_PAYLOAD_LEN || !data) {
     return 0;
   }
-  uint32_t pkt_addr = fifo_put(&out_buffer);
-  if(FIFO_ERROR != pkt_addr) {
+#if LWB_VERSION == 2
+  uint8_t* payload = lwb_reserve_data();
+#else /* LWB_VERSION */
+  uint8_t* payload = lwb_reserve_data(recipient, stream_id);
+#endif /* LWB_VERSION */
+  if(payload) {
+    memcpy(payload, data, len);
+    return lwb_commit_data(len);
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* returns a pointer to the payload of the oldest received message in the 
+ * queue without removing it */
+#if LWB_VERSION == 2
+const uint8_t*
+lwb_peek_data(uint8_t * const out_len)
+#else /* LWB_VERSION */
+const uint8_t*
+lwb_peek_data(uint8_t * const out_len,
+              uint16_t * const out_node_id, 
+              uint8_t * const out_stream_id)
+#endif /* LWB_VERSION */
+{ 
+  /* lwb header needs to be stripped off; payload has max. length
+   * LWB_DATA_PKT_PAYLOAD_LEN */
+  uint32_t pkt_addr = bfifo_peek(&in_buffer);
+  if(BFIFO_ERROR != pkt_addr) {
+    uint8_t len = lwb_buffer_peek_len(&in_buffer);
 #if !LWB_CONF_USE_XMEM
     /* assume pointers are 16-bit */
-    uint8_t* next_msg = (uint8_t*)(uint16_t)pkt_addr;  
-    *(next_msg) = (uint8_t)recipient;   /* recipient L */  
-    *(next_msg + 1) = recipient >> 8;   /* recipient H */  
-    *(next_msg + 2) = stream_id; 
-    *(next_msg + LWB_CONF_MAX_DATA_PKT_LEN) = len + LWB_DATA_PKT_HEADER_LEN;
-    memcpy(next_msg + LWB_DATA_PKT_HEADER_LEN, data, len);
+    uint8_t* next_msg = (uint8_t*)(uint16_t)pkt_addr + 1; 
 #else /* LWB_CONF_USE_XMEM */
-    *(data_buffer) = (uint8_t)recipient;   /* recipient L */  
-    *(data_buffer + 1) = recipient >> 8;   /* recipient H */
-    *(data_buffer + 2) = stream_id;
-    *(data_buffer + LWB_CONF_MAX_DATA_PKT_LEN) = len + LWB_DATA_PKT_HEADER_LEN;
-    memcpy(data_buffer + LWB_DATA_PKT_HEADER_LEN, data, len);
-    /* always read the max length since we don't know how long the packet is */
-    xmem_write(pkt_addr, LWB_CONF_MAX_DATA_PKT_LEN + 1, data_buffer);
+    uint8_t* next_msg = data_buffer + 1;
+    xmem_read(pkt_addr + 1, len, next_msg);
 #endif /* LWB_CONF_USE_XMEM */
-    return 1;
+    if(out_len) {
+      *out_len = len - LWB_DATA_PKT_HEADER_LEN;
+    }
+#if LWB_VERSION == 1
+    if(out_node_id) {
+      /* cant just treat next_msg as 16-bit value due to misalignment */
+      *out_node_id = LWB_PKT_RECIPIENT(next_msg);
+    }
+    if(out_stream_id) {
+      *out_stream_id = LWB_PKT_STREAM_ID(next_msg);
+    }
+#endif /* LWB_VERSION */
+    return next_msg + LWB_DATA_PKT_HEADER_LEN;
   }
-  DEBUG_PRINT_VERBOSE("out queue full");
+  DEBUG_PRINT_VERBOSE("in queue empty");
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+lwb_release_data(void)
+{
+  LWB_QUEUE_ATOMIC(bfifo_drop(&in_buffer, 
+                              lwb_buffer_peek_len(&in_buffer) + 1));
+}
+/*---------------------------------------------------------------------------*/
 /* copies the oldest received message in the queue into out_data and returns 
  * the message size (in bytes) */
+#if LWB_VERSION == 2
+uint8_t
+lwb_get_data(uint8_t* out_data)
+{ 
+  uint8_t msg_len;
+  if(!out_data) { return 0; }
+  const uint8_t* msg = lwb_peek_data(&msg_len);
+#else /* LWB_VERSION */
 uint8_t
 lwb_get_data(uint8_t* out_data, 
              uint16_t * const out_node_id, 
              uint8_t * const out_stream_id)
 { 
+  uint8_t msg_len;
   if(!out_data) { return 0; }
-  /* messages in the queue have the max. length LWB_CONF_MAX_DATA_PKT_LEN, 
-   * lwb header needs to be stripped off; payload has max. length
-   * LWB_DATA_PKT_PAYLOAD_LEN */
-  uint32_t pkt_addr = fifo_get(&in_buffer);
-  if(FIFO_ERROR != pkt_addr) {
-#if !LWB_CONF_USE_XMEM
-    /* assume pointers are 16-bit */
-    uint8_t* next_msg = (uint8_t*)(uint16_t)pkt_addr; 
-    uint8_t msg_len = *(next_msg + LWB_CONF_MAX_DATA_PKT_LEN) -
-                      LWB_DATA_PKT_HEADER_LEN;
-    memcpy(out_data, next_msg + LWB_DATA_PKT_HEADER_LEN, msg_len);
-    if(out_node_id) {
-      /* cant just treat next_msg as 16-bit value due to misalignment */
-      *out_node_id = (uint16_t)next_msg[1] << 8 | next_msg[0];
+  const uint8_t* msg = lwb_peek_data(&msg_len, out_node_id, out_stream_id);
+#endif /* LWB_VERSION */
+  if(msg) {
+    memcpy(out_data, msg, msg_len);
+    lwb_release_data();
+    return msg_len;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* inserts n messages with the layout LWB_BATCH_PAYLOAD into the outgoing 
+ * queue (one copy / memory access per contiguous block) */
+#if LWB_VERSION == 2
+uint8_t
+lwb_put_data_batch(uint8_t* buf,
+                   const uint8_t* len,
+                   uint8_t n)
+{
+  uint8_t  k, m, cnt = 0;
+  uint16_t ofs = 0, blk_len;
+  uint32_t pkt_addr;
+  struct bfifo* q = out_buffer;
+  if(!buf || !len) {
+    return 0;
+  }
+#else /* LWB_VERSION */
+uint8_t
+lwb_put_data_batch(uint16_t recipient,
+                   uint8_t stream_id,
+                   uint8_t* buf,
+                   const uint8_t* len,
+                   uint8_t n)
+{
+  uint8_t  k, m, cnt = 0;
+  uint16_t ofs = 0, blk_len;
+  uint32_t pkt_addr;
+  struct bfifo* q = LWB_OUT_QUEUE(stream_id);
+  if(!buf || !len || LWB_STREAM_ID_RESERVED(stream_id)) {
+    return 0;
+  }
+#endif /* LWB_VERSION */
+  if(out_resv_open) {
+    /* the reserved block would be overwritten */
+    DEBUG_PRINT_VERBOSE("reservation pending");
+    return 0;
+  }
+  /* pack the messages in the user buffer (the same format as in the queue: 
+   * length, header, payload), this never overwrites unprocessed messages */
+  for(k = 0; k < n; k++) {
+    if(len[k] > LWB_DATA_PKT_PAYLOAD_LEN) {
+      n = k;                      /* invalid length, stop at this message */
+      break;
     }
-    if(out_stream_id) {
-      *out_stream_id = next_msg[2];
+    uint8_t* msg = buf + (uint16_t)k * LWB_BATCH_STRIDE;
+#if LWB_VERSION == 1
+    *(msg) = (uint8_t)recipient;   /* recipient L */  
+    *(msg + 1) = recipient >> 8;   /* recipient H */  
+    *(msg + 2) = stream_id; 
+#endif /* LWB_VERSION */
+    memmove(buf + ofs + 1, msg, len[k] + LWB_DATA_PKT_HEADER_LEN);
+    buf[ofs] = len[k] + LWB_DATA_PKT_HEADER_LEN;
+    ofs += len[k] + LWB_DATA_PKT_HEADER_LEN + 1;
+  }
+  ofs = 0;
+  while(cnt < n) {
+    /* find the largest number of messages that fit into a contiguous block
+     * (at most 2 iterations due to the wrap-around) */
+    blk_len = 0;
+    for(k = cnt; k < n; k++) {
+      blk_len += len[k] + LWB_DATA_PKT_HEADER_LEN + 1;
     }
-#else /* LWB_CONF_USE_XMEM */
-    xmem_read(pkt_addr, LWB_CONF_MAX_DATA_PKT_LEN + 1, data_buffer);
-    uint8_t msg_len = *(data_buffer + LWB_CONF_MAX_DATA_PKT_LEN) -
-                      LWB_DATA_PKT_HEADER_LEN;
-    memcpy(out_data, data_buffer + LWB_DATA_PKT_HEADER_LEN, msg_len);
-    if(out_node_id) {
-      memcpy(out_node_id, data_buffer, 2);
+    for(m = n - cnt; m > 0; m--) {
+      LWB_QUEUE_ATOMIC(pkt_addr = bfifo_reserve(q, blk_len));
+      if(BFIFO_ERROR != pkt_addr) {
+        break;
+      }
+      blk_len -= len[cnt + m - 1] + LWB_DATA_PKT_HEADER_LEN + 1;
     }
-    if(out_stream_id) {
-      *out_stream_id = data_buffer[2];
+    if(!m) {
+      DEBUG_PRINT_VERBOSE("out queue full");
+      break;
     }
+#if !LWB_CONF_USE_XMEM
+    memcpy((uint8_t*)(uint16_t)pkt_addr, buf + ofs, blk_len);
+#else /* LWB_CONF_USE_XMEM */
+    xmem_write(pkt_addr, blk_len, buf + ofs);
 #endif /* LWB_CONF_USE_XMEM */
-    return msg_len;
+    LWB_QUEUE_ATOMIC(bfifo_put_n(q, blk_len, m));
+    ofs += blk_len;
+    cnt += m;
   }
-  DEBUG_PRINT_VERBOSE("in queue empty");
-  return 0;
+  return cnt;
+}
+/*---------------------------------------------------------------------------*/
+/* fetches up to n messages from the incoming queue (one copy / memory access 
+ * per contiguous block) */
+#if LWB_VERSION == 2
+uint8_t
+lwb_get_data_batch(uint8_t* out_buf,
+                   uint8_t n,
+                   uint8_t* out_len)
+#else /* LWB_VERSION */
+uint8_t
+lwb_get_data_batch(uint8_t* out_buf,
+                   uint8_t n,
+                   uint8_t* out_len,
+                   uint16_t * const out_node_id,
+                   uint8_t * const out_stream_id)
+#endif /* LWB_VERSION */
+{
+  uint8_t  k, m, cnt = 0;
+  uint16_t blk_len, ofs;
+  if(!out_buf || !out_len) { return 0; }
+  /* at most 2 iterations (wrap-around) */
+  while(cnt < n && !BFIFO_EMPTY(&in_buffer)) {
+    uint8_t* blk = out_buf + (uint16_t)cnt * LWB_BATCH_STRIDE;
+    blk_len = BFIFO_CONTIG_READ(&in_buffer);
+    if(blk_len > (uint16_t)(n - cnt) * LWB_BATCH_STRIDE) {
+      blk_len = (uint16_t)(n - cnt) * LWB_BATCH_STRIDE;
+    }
+#if !LWB_CONF_USE_XMEM
+    memcpy(blk, (uint8_t*)(uint16_t)BFIFO_READ_ADDR(&in_buffer), blk_len);
+#else /* LWB_CONF_USE_XMEM */
+    xmem_read(BFIFO_READ_ADDR(&in_buffer), blk_len, blk);
+#endif /* LWB_CONF_USE_XMEM */
+    /* count the complete messages in the block */
+    ofs = 0;
+    for(m = 0; cnt + m < n && ofs < blk_len && 
+               (ofs + blk[ofs] + 1) <= blk_len; m++) {
+      out_len[cnt + m] = blk[ofs];
+      ofs += blk[ofs] + 1;
+      LWB_QUEUE_ATOMIC(bfifo_drop(&in_buffer, out_len[cnt + m] + 1));
+    }
+    /* move the messages to their final position (in reverse order, the 
+     * target position is never in front of the source position) */
+    for(k = m; k > 0; k--) {
+      ofs -= out_len[cnt + k - 1] + 1;
+      memmove(blk + (uint16_t)(k - 1) * LWB_BATCH_STRIDE, blk + ofs + 1, 
+              out_len[cnt + k - 1]);
+    }
+    for(k = cnt; k < cnt + m; k++) {
+      out_len[k] -= LWB_DATA_PKT_HEADER_LEN;
+#if LWB_VERSION == 1
+      uint8_t* msg = out_buf + (uint16_t)k * LWB_BATCH_STRIDE;
+      if(out_node_id) {
+        out_node_id[k] = LWB_PKT_RECIPIENT(msg);
+      }
+      if(out_stream_id) {
+        out_stream_id[k] = LWB_PKT_STREAM_ID(msg);
+      }
+#endif /* LWB_VERSION */
+    }
+    if(!m) {
+      break;      /* should not happen */
+    }
+    cnt += m;
+  }
+  return cnt;
 }
 /*---------------------------------------------------------------------------*/
 uint8_t
 lwb_get_rcv_buffer_state(void)
 {
-  return !FIFO_EMPTY(&in_buffer);
+  return !BFIFO_EMPTY(&in_buffer);
 }
 /*---------------------------------------------------------------------------*/
 uint8_t
 lwb_get_send_buffer_state(void)
 {
-  return out_buffer.count; /* !FIFO_EMPTY(&out_buffer); */
+  uint8_t k, cnt = 0;
+  for(k = 0; k < LWB_CONF_OUT_N_QUEUES; k++) {
+    cnt += out_buffer[k].count;
+  }
+  return cnt;
+}
+#endif /* LWB_CONF_RELAY_ONLY */
+/*---------------------------------------------------------------------------*/
+#if LWB_VERSION == 1       /* version 2 packets can't carry stream requests */
+#if !LWB_CONF_RELAY_ONLY
+/* appends a stream request to the data packet (if there is enough space) and 
+ * returns the new packet length */
+static uint8_t
+lwb_append_srq(uint8_t* pkt, uint8_t len, uint8_t stream_id)
+{
+  lwb_stream_req_t srq;
+  if((len + LWB_PIGGYBACK_SRQ_LEN) > LWB_CONF_MAX_DATA_PKT_LEN ||
+     !lwb_stream_prepare_req(&srq, stream_id)) {
+    return len;
+  }
+  /* skip the node ID and the padding byte */
+  memcpy(pkt + len, (uint8_t*)&srq + 3, LWB_PIGGYBACK_SRQ_LEN);
+  if(pkt[2] != LWB_INVALID_STREAM_ID) {
+    pkt[2] |= LWB_PIGGYBACK_SRQ_FLAG;
+  }
+  return len + LWB_PIGGYBACK_SRQ_LEN;
 }
 #endif /* LWB_CONF_RELAY_ONLY */
 /*---------------------------------------------------------------------------*/
+/* removes the stream request from the end of the data packet and returns the
+ * remaining packet length (0 if the packet carried nothing else) */
+static uint8_t
+lwb_strip_srq(uint8_t* pkt, uint8_t len, lwb_stream_req_t* const out_srq)
+{
+  if(len < (LWB_DATA_PKT_HEADER_LEN + LWB_PIGGYBACK_SRQ_LEN)) {
+    return len;                                   /* invalid packet length */
+  }
+  len -= LWB_PIGGYBACK_SRQ_LEN;
+  if(out_srq) {
+    /* copy into an aligned structure */
+    memcpy((uint8_t*)out_srq + 3, pkt + len, LWB_PIGGYBACK_SRQ_LEN);
+  }
+  if(pkt[2] == LWB_INVALID_STREAM_ID) {
+    return 0;
+  }
+  pkt[2] &= ~LWB_PIGGYBACK_SRQ_FLAG;
+  return len;
+}
+#endif /* LWB_VERSION */
+/*---------------------------------------------------------------------------*/
 const lwb_statistics_t * const
 lwb_get_stats(void)
 {
   return &stats;
 }
 /*---------------------------------------------------------------------------*/
+#if LWB_CONF_SYNC_STATS
+/* HF clock ticks to us and clock drift to ppm */
+#define LWB_TICKS_TO_US(t)        ((int64_t)(t) * 1000000 / \
+                                   (int32_t)RTIMER_SECOND_HF)
+#if LWB_CONF_USE_LF_FOR_WAKEUP
+#define LWB_DRIFT_TO_PPM(d)       ((d) / 8)
+#else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+#define LWB_DRIFT_TO_PPM(d)       ((d) * 100 / 325)
+#endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+/* index of the p-th percentile in a sorted array of n values */
+#define LWB_PCTL(n, p)            ((uint16_t)((n) - 1) * (p) / 100)
+/* adds the record of the last round to the ring (overwrites the oldest) */
+static void
+lwb_sync_stats_add(const lwb_sync_rec_t* rec)
+{
+  sync_rec[sync_rec_idx] = *rec;
+  sync_rec_idx++;
+  if(sync_rec_idx >= LWB_CONF_SYNC_STATS) {
+    sync_rec_idx = 0;
+  }
+  if(sync_rec_cnt < LWB_CONF_SYNC_STATS) {
+    sync_rec_cnt++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* insertion sort (n is small) */
+static void
+lwb_sort(int32_t* v, uint8_t n)
+{
+  uint8_t i, j;
+  int32_t tmp;
+
+  for(i = 1; i < n; i++) {
+    tmp = v[i];
+    for(j = i; j && v[j - 1] > tmp; j--) {
+      v[j] = v[j - 1];
+    }
+    v[j] = tmp;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwb_get_sync_stats(lwb_sync_stats_t* out)
+{
+  static lwb_sync_rec_t rec[LWB_CONF_SYNC_STATS];
+  static int32_t v[LWB_CONF_SYNC_STATS];
+  uint8_t i, n, n1;
+
+  if(!out) {
+    return 0;
+  }
+  memset(out, 0, sizeof(lwb_sync_stats_t));
+  /* the records are written by the LWB task */
+  LWB_ATOMIC(n = sync_rec_cnt; 
+             memcpy(rec, sync_rec, sizeof(lwb_sync_rec_t) * n));
+  if(!n) {
+    return 0;
+  }
+  out->n_rounds = n;
+  for(i = 0; i < n; i++) {
+    if(rec[i].sched == 1) {
+      out->n_sched1++;
+    } else if(rec[i].sched == 2) {
+      out->n_sched2++;
+    }
+    if(rec[i].anomaly) {
+      out->n_anomalies++;
+    }
+  }
+  /* guard time and drift: all rounds */
+  for(i = 0; i < n; i++) {
+    v[i] = rec[i].guard;
+  }
+  lwb_sort(v, n);
+  out->guard_p50 = v[LWB_PCTL(n, 50)];
+  out->guard_max = v[n - 1];
+  for(i = 0; i < n; i++) {
+    v[i] = rec[i].drift;
+  }
+  lwb_sort(v, n);
+  out->drift_min = v[0];
+  out->drift_p50 = v[LWB_PCTL(n, 50)];
+  out->drift_max = v[n - 1];
+  /* offset, relay count and SNR: rounds synced on the 1st schedule */
+  n1 = out->n_sched1;
+  if(!n1) {
+    return n;
+  }
+  for(i = 0, n1 = 0; i < n; i++) {
+    if(rec[i].sched == 1) {
+      v[n1++] = (rec[i].ofs < 0) ? -(int32_t)rec[i].ofs : rec[i].ofs;
+    }
+  }
+  lwb_sort(v, n1);
+  out->ofs_p50 = v[LWB_PCTL(n1, 50)];
+  out->ofs_p90 = v[LWB_PCTL(n1, 90)];
+  out->ofs_max = v[n1 - 1];
+  for(i = 0, n1 = 0; i < n; i++) {
+    if(rec[i].sched == 1) {
+      v[n1++] = rec[i].relay_cnt;
+    }
+  }
+  lwb_sort(v, n1);
+  out->relay_p50 = v[LWB_PCTL(n1, 50)];
+  out->relay_max = v[n1 - 1];
+  for(i = 0, n1 = 0; i < n; i++) {
+    if(rec[i].sched == 1) {
+      v[n1++] = rec[i].snr;
+    }
+  }
+  lwb_sort(v, n1);
+  out->snr_p10 = v[LWB_PCTL(n1, 10)];
+  out->snr_p50 = v[LWB_PCTL(n1, 50)];
+  return n;
+}
+#endif /* LWB_CONF_SYNC_STATS */
+/*---------------------------------------------------------------------------*/
 uint8_t
 lwb_request_stream(lwb_stream_req_t* stream_request, uint8_t urgent)
 {
   if(!stream_request) { return 0; }
+#if LWB_VERSION == 2
+  /* single stream per node, requests are only sent in the contention slot */
+  stream_request->stream_id = LWB_DEFAULT_STREAM_ID;
+#else /* LWB_VERSION */
   if(urgent) {
     urgent_stream_req = stream_request->stream_id;
   }
+#endif /* LWB_VERSION */
   return lwb_stream_add(stream_request);
 }
 /*---------------------------------------------------------------------------*/
@@ -502,9 +1542,119 @@ lwb_get_time(rtimer_clock_t* reception_time)
   if(reception_time) {
     *reception_time = reception_timestamp;
   }
-  return global_time;
+  return global_time / LWB_CONF_PERIOD_SCALE;
+}
+/*---------------------------------------------------------------------------*/
+#define LWB_TIME_FP               24
+/* length of an HF clock tick in us (not drift compensated) */
+#define LWB_HF_TICK_US            (((uint64_t)1000000 << LWB_TIME_FP) / \
+                                   RTIMER_SECOND_HF)
+/* sets the network time reference: time is the network time in units of 
+ * 1/LWB_CONF_PERIOD_SCALE seconds at the local timestamp ts, drift is the 
+ * clock drift (unit of LWB_CONF_MAX_CLOCK_DEV) */
+static void
+lwb_set_time_ref(uint32_t time, rtimer_clock_t ts, int32_t drift)
+{
+  time_ref_us = (uint64_t)time * 1000000 / LWB_CONF_PERIOD_SCALE;
+  time_ref_ticks = ts;
+#if LWB_CONF_USE_LF_FOR_WAKEUP
+  time_tick_us = ((uint64_t)1000000 << (LWB_TIME_FP + 8)) / 
+                 ((int64_t)RTIMER_SECOND_LF * 256 + drift);
+#else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+  time_tick_us = ((uint64_t)1000000 << LWB_TIME_FP) / 
+                 ((int64_t)RTIMER_SECOND_HF + drift);
+#endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+}
+/*---------------------------------------------------------------------------*/
+uint64_t
+lwb_timestamp_from_rtimer(rtimer_clock_t hf_timestamp)
+{
+  uint64_t ref_us;
+  rtimer_clock_t ref_ticks;
+  uint32_t tick_us;
+  int64_t elapsed;
+  LWB_ATOMIC(ref_us = time_ref_us; ref_ticks = time_ref_ticks; 
+             tick_us = time_tick_us);
+  if(!tick_us) {
+    tick_us = LWB_HF_TICK_US;         /* no time reference yet */
+  }
+#if LWB_CONF_USE_LF_FOR_WAKEUP
+  /* the HF clock may have been stopped since the reference was taken: go 
+   * via the current LF time */
+  rtimer_clock_t hf_now, lf_now;
+  rtimer_now(&hf_now, &lf_now);
+  elapsed = (((int64_t)(lf_now - ref_ticks) * tick_us) - 
+             ((int64_t)(hf_now - hf_timestamp) * LWB_HF_TICK_US)) >> 
+            LWB_TIME_FP;
+#else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+  elapsed = ((int64_t)(hf_timestamp - ref_ticks) * tick_us) >> LWB_TIME_FP;
+#endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+  return ref_us + elapsed;
+}
+/*---------------------------------------------------------------------------*/
+uint64_t
+lwb_get_time_us(void)
+{
+  return lwb_timestamp_from_rtimer(rtimer_now_hf());
+}
+/*---------------------------------------------------------------------------*/
+#if LWB_LF_CALIB
+/* captures the HF and the LF timer right after an edge of the LF clock
+ * (busy waits for at most one LF clock tick) */
+static void
+lwb_lf_edge(rtimer_clock_t* hf, rtimer_clock_t* lf)
+{
+  rtimer_clock_t lf_start;
+  rtimer_now(hf, &lf_start);
+  do {
+    rtimer_now(hf, lf);
+  } while(*lf == lf_start);
+}
+/*---------------------------------------------------------------------------*/
+/* converts the LF timestamp lf into an HF timestamp, based on the current LF
+ * clock edge and the measured clock ratio; the edge is kept as the first
+ * sample for the calibration (see lwb_lf_calib_update) */
+static rtimer_clock_t
+lwb_lf_anchor(rtimer_clock_t lf)
+{
+  lwb_lf_edge(&calib_hf, &calib_lf);
+  calib_valid = 1;
+  if(lf >= calib_lf) {
+    return calib_hf + (((lf - calib_lf) * hf_lf_ratio) >> 16);
+  }
+  return calib_hf - (((calib_lf - lf) * hf_lf_ratio) >> 16);
 }
 /*---------------------------------------------------------------------------*/
+/* measures the HF/LF clock ratio since the last anchor (the HF clock must
+ * have been running in the meantime) and updates the estimate */
+static void
+lwb_lf_calib_update(void)
+{
+  rtimer_clock_t hf_now, lf_now;
+  uint32_t sample;
+
+  if(!calib_valid) {
+    return;
+  }
+  calib_valid = 0;
+  lwb_lf_edge(&hf_now, &lf_now);
+  if((lf_now - calib_lf) < 32) {
+    return;                       /* too short for a meaningful measurement */
+  }
+  sample = ((hf_now - calib_hf) << 16) / (lf_now - calib_lf);
+  /* discard samples that deviate by more than 1% from the nominal ratio */
+  if(sample > (uint32_t)(((uint64_t)RTIMER_SECOND_HF << 16) /
+                         RTIMER_SECOND_LF * 101 / 100) ||
+     sample < (uint32_t)(((uint64_t)RTIMER_SECOND_HF << 16) /
+                         RTIMER_SECOND_LF * 99 / 100)) {
+    DEBUG_PRINT_WARNING("invalid HF/LF ratio %lu", sample);
+    return;
+  }
+  hf_lf_ratio = (int32_t)hf_lf_ratio + ((int32_t)sample -
+                                        (int32_t)hf_lf_ratio) / 8;
+}
+#endif /* LWB_LF_CALIB */
+/*---------------------------------------------------------------------------*/
 #if !LWB_CONF_RELAY_ONLY
 /**
  * @brief thread of the host node
@@ -521,11 +1671,21 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
   static glossy_payload_t glossy_payload;                   /* packet buffer */
   /* constant guard time for the host */
   static const uint32_t t_guard = LWB_CONF_T_GUARD; 
+  static uint32_t t_sched2;
   static uint8_t slot_idx;
   static uint8_t streams_to_update[LWB_CONF_MAX_DATA_SLOTS];
   static uint8_t schedule_len, 
                  payload_len;
   static uint8_t rcvd_data_pkts;
+  static uint8_t* rx_pkt;                   /* receive buffer for data */
+  static uint8_t* tx_pkt;                   /* message to send */
+#if LWB_CONF_DATA_ACK
+  static lwb_dack_pkt_t dack;               /* D-ACK for the last round */
+  static uint8_t dack_len = 0;
+#endif /* LWB_CONF_DATA_ACK */
+#if LWB_CONF_BOOT_BEACON_INTERVAL
+  static uint16_t beacon_cnt;     /* # beacon intervals until the next round */
+#endif /* LWB_CONF_BOOT_BEACON_INTERVAL */
   static int8_t  glossy_rssi = 0;
   static const void* callback_func = lwb_thread_host;
 
@@ -537,13 +1697,27 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
   memset(&schedule, 0, sizeof(schedule));
   
   /* initialization specific to the host node */
-  schedule_len = lwb_sched_init(&schedule);
   sync_state = SYNCED;  /* the host is always 'synced' */
-  
-  rtimer_reset();
+#if LWB_CONF_STANDBY_HOST_ID
+  if(standby_active) {
+    /* continue the rounds of the failed host with the mirrored streams, 
+     * rt->time is the expected start of the next round */
+    schedule_len = lwb_sched_takeover(&schedule, standby_time, 
+                                      standby_period);
+  } else
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+  {
+    schedule_len = lwb_sched_init(&schedule);
+#if LWB_CONF_CHECKPOINT
+    if(lwb_sched_load(&schedule, ckpt_addr)) {
+      DEBUG_PRINT_MSG_NOW("warm restart (t=%lu)", schedule.time);
+    }
+#endif /* LWB_CONF_CHECKPOINT */
+    rtimer_reset();
 #if LWB_CONF_USE_LF_FOR_WAKEUP 
-  rt->time = 0; //rtimer_now_lf();
+    rt->time = 0; //rtimer_now_lf();
 #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+  }
   
   while(1) {
 #if LWB_CONF_T_PREPROCESS
@@ -559,7 +1733,16 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
   #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
 #endif /* LWB_CONF_T_PREPROCESS */
 
-#if LWB_CONF_USE_LF_FOR_WAKEUP 
+#if LWB_LF_CALIB
+    /* the timer fired LWB_CONF_LF_SETTLE early: start the round exactly at
+     * the LF time on the (now stable) HF timer */
+    t_start_lf = rt->time + LWB_CONF_LF_SETTLE;
+    rt->time = lwb_lf_anchor(t_start_lf);
+    if(rt->time > rtimer_now_hf()) {
+      LWB_WAIT_UNTIL(rt->time);
+    }
+    t_start = rt->time;
+#elif LWB_CONF_USE_LF_FOR_WAKEUP 
     t_start_lf = rt->time; 
     rt->time = rtimer_now_hf();
     t_start = rt->time;
@@ -573,6 +1756,11 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
     
     global_time = schedule.time;
     reception_timestamp = t_start;
+#if LWB_CONF_USE_LF_FOR_WAKEUP
+    lwb_set_time_ref(schedule.time, t_start_lf, 0);
+#else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+    lwb_set_time_ref(schedule.time, t_start, 0);
+#endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
     LWB_SCHED_SET_AS_1ST(&schedule);          /* mark this schedule as first */
     LWB_SEND_SCHED();            /* send the previously computed schedule */
     glossy_rssi = glossy_get_rssi(0);
@@ -602,6 +1790,24 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
     } else {
       DEBUG_PRINT_VERBOSE("no sack slot");
     }
+    
+#if LWB_CONF_DATA_ACK
+    /* --- D-ACK SLOT --- */
+    
+    if(LWB_SCHED_HAS_DACK_SLOT(&schedule)) {
+      /* acknowledge the data packets received in the last round */
+      payload_len = dack_len ? dack_len : LWB_DACK_PKT_HEADER_LEN;
+      memcpy(&glossy_payload.dack_pkt, &dack, payload_len);
+      LWB_WAIT_UNTIL(t_start + LWB_T_SLOT_START(slot_idx));
+      LWB_SEND_PACKET();
+      DEBUG_PRINT_VERBOSE("D-ACK sent");
+      slot_idx++;
+    }
+    dack.time = (uint16_t)schedule.time;
+    memset(dack.bitmap, 0, LWB_DACK_BITMAP_LEN);
+    dack_len = LWB_DACK_PKT_HEADER_LEN + 
+               (LWB_SCHED_N_SLOTS(&schedule) + 7) / 8;
+#endif /* LWB_CONF_DATA_ACK */
          
     /* --- DATA SLOTS --- */
     
@@ -614,48 +1820,67 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
          * to the host */
         if(schedule.slot[i] == 0 || schedule.slot[i] == node_id) {
           /* send a data packet (if there is any) */
-          payload_len = lwb_out_buffer_get(glossy_payload.raw_data);
+          tx_pkt = lwb_out_buffer_get(glossy_payload.raw_data, &payload_len);
           if(payload_len) { 
             /* note: stream ID is irrelevant here */
             /* wait until the data slot starts */
             LWB_WAIT_UNTIL(t_start + LWB_T_SLOT_START(slot_idx));  
-            LWB_SEND_PACKET();
+            LWB_SEND_PACKET_FROM(tx_pkt);
+            lwb_out_buffer_release();         /* remove it from the queue */
             DEBUG_PRINT_VERBOSE("data packet sent (%ub)", payload_len);
           }
         } else {        
           /* wait until the data slot starts */
           LWB_DATA_SLOT_STARTS;
           LWB_WAIT_UNTIL(t_start + LWB_T_SLOT_START(slot_idx) - t_guard); 
-          LWB_RCV_PACKET();  /* receive a data packet */
+          rx_pkt = lwb_in_buffer_reserve(glossy_payload.raw_data);
+          LWB_RCV_PACKET_INTO(rx_pkt);  /* receive a data packet */
           payload_len = glossy_get_payload_len();
           if(LWB_DATA_RCVD && payload_len) {
             /* measure the time it takes to process the received message */
             RTIMER_CAPTURE;   
-            if(glossy_payload.data_pkt.recipient == node_id || 
-               glossy_payload.data_pkt.recipient == LWB_RECIPIENT_SINKS ||
-               glossy_payload.data_pkt.recipient == LWB_RECIPIENT_BROADCAST || 
-               glossy_payload.data_pkt.recipient == LWB_RECIPIENT_HOST) {
-              /* is it a stream request? (piggyback on data packet) */
-              if(LWB_INVALID_STREAM_ID == glossy_payload.data_pkt.stream_id) {
-                DEBUG_PRINT_VERBOSE("piggyback stream request from node %u", 
-                                 glossy_payload.srq_pkt.id);
-                lwb_sched_proc_srq((lwb_stream_req_t*)
-                                   &glossy_payload.raw_data[3]);
-              } else 
-              {
-                streams_to_update[i] = glossy_payload.data_pkt.stream_id;
-                DEBUG_PRINT_VERBOSE("data received (s=%u.%u l=%u)", 
-                                    schedule.slot[i], 
-                                    glossy_payload.data_pkt.stream_id, 
-                                    payload_len);
-                /* replace target node ID by sender node ID */
-                glossy_payload.data_pkt.recipient = schedule.slot[i];
-                lwb_in_buffer_put(glossy_payload.raw_data, 
+#if LWB_CONF_DATA_ACK
+            dack.bitmap[i >> 3] |= (1 << (i & 7));
+#endif /* LWB_CONF_DATA_ACK */
+#if LWB_VERSION == 2
+            /* all data packets are destined for the host */
+            streams_to_update[i] = LWB_DEFAULT_STREAM_ID;
+            DEBUG_PRINT_VERBOSE("data received (s=%u l=%u)", 
+                                schedule.slot[i], payload_len);
+            if(lwb_in_buffer_put_pkt(rx_pkt, payload_len, 
+                                     glossy_payload.raw_data)) {
+              LWB_RX_NOTIFY_APP;
+            }
+#else /* LWB_VERSION */
+            /* is there a stream request? (piggyback on data packet) */
+            if(LWB_PKT_HAS_SRQ(rx_pkt)) {
+              lwb_stream_req_t srq;
+              payload_len = lwb_strip_srq(rx_pkt, payload_len, &srq);
+              srq.id = schedule.slot[i];
+              DEBUG_PRINT_VERBOSE("piggyback stream request from node %u", 
+                                  srq.id);
+              lwb_sched_proc_srq(&srq);
+            }
+            if(payload_len && 
+               (LWB_PKT_RECIPIENT(rx_pkt) == node_id || 
+                LWB_PKT_RECIPIENT(rx_pkt) == LWB_RECIPIENT_SINKS ||
+                LWB_PKT_RECIPIENT(rx_pkt) == LWB_RECIPIENT_BROADCAST || 
+                LWB_PKT_RECIPIENT(rx_pkt) == LWB_RECIPIENT_HOST)) {
+              streams_to_update[i] = LWB_PKT_DATA_STREAM_ID(rx_pkt);
+              DEBUG_PRINT_VERBOSE("data received (s=%u.%u l=%u)", 
+                                  schedule.slot[i], 
+                                  streams_to_update[i], 
                                   payload_len);
+              /* replace target node ID by sender node ID */
+              LWB_PKT_SET_RECIPIENT(rx_pkt, schedule.slot[i]);
+              if(lwb_in_buffer_put_pkt(rx_pkt, payload_len, 
+                                       glossy_payload.raw_data)) {
+                LWB_RX_NOTIFY_APP;
               }
-            } else {
+            } else if(payload_len) {
               DEBUG_PRINT_VERBOSE("packet dropped, not destined for me");      
             }
+#endif /* LWB_VERSION */
             /* update statistics */
             stats.data_tot += payload_len;
             stats.pck_cnt++;
@@ -673,28 +1898,49 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
     /* --- CONTENTION SLOT --- */
     
     if(LWB_SCHED_HAS_CONT_SLOT(&schedule)) {
-      /* wait until the slot starts, then receive the packet */
-      LWB_WAIT_UNTIL(t_start + LWB_T_SLOT_START(slot_idx) - t_guard);
-      LWB_RCV_SRQ();
-      if(LWB_DATA_RCVD) {
-        LWB_REQ_DETECTED;
-        /* check the request */
-        /*DEBUG_PRINT_INFO("stream request from node %u (stream %u, IPI %u)", 
-                         glossy_payload.srq_pkt.id, 
-                         glossy_payload.srq_pkt.stream_id, 
-                         glossy_payload.srq_pkt.ipi);*/
-        lwb_sched_proc_srq(&glossy_payload.srq_pkt);
+      static uint8_t j;             /* must be static */
+      static uint8_t n_coll;
+      n_coll = 0;
+      for(j = 0; j < LWB_CONF_CONT_N_MINISLOTS; j++) {
+        /* wait until the mini-slot starts, then receive the packet */
+        LWB_WAIT_UNTIL(t_start + LWB_T_SLOT_START(slot_idx) + 
+                       LWB_T_MINISLOT_START(j) - t_guard);
+        LWB_RCV_SRQ();
+        if(LWB_DATA_RCVD) {
+          LWB_REQ_DETECTED;
+          /* check the request */
+          /*DEBUG_PRINT_INFO("stream request from node %u (stream %u, IPI %u)", 
+                           glossy_payload.srq_pkt.id, 
+                           glossy_payload.srq_pkt.stream_id, 
+                           glossy_payload.srq_pkt.ipi);*/
+          lwb_sched_proc_srq(&glossy_payload.srq_pkt);
+        } else if(LWB_COLLISION_DETECTED) {
+          n_coll++;
+        }
+      }
+      if(n_coll) {
+        DEBUG_PRINT_VERBOSE("%u collision(s) in the contention slot", n_coll);
+        lwb_sched_notify_collision(n_coll);
       }
     }
 
+    /* the 2nd schedule follows right after the last slot of this round */
+    t_sched2 = LWB_T_SCHED2_START(&schedule);
+    
     /* compute the new schedule */
     RTIMER_CAPTURE;
     schedule_len = lwb_sched_compute(&schedule, 
                                      streams_to_update, 
                                      lwb_get_send_buffer_state());
     stats.t_sched_max = MAX((uint16_t)RTIMER_ELAPSED, stats.t_sched_max);
+#if LWB_CONF_SCHED2_EARLY
+    if(stats.t_sched_max > LWB_CONF_T_SCHED2_MARGIN * 1000 / 3250) {
+      DEBUG_PRINT_WARNING("LWB_CONF_T_SCHED2_MARGIN too short (%uus)", 
+                          stats.t_sched_max);
+    }
+#endif /* LWB_CONF_SCHED2_EARLY */
 
-    LWB_WAIT_UNTIL(t_start + LWB_CONF_T_SCHED2_START);
+    LWB_WAIT_UNTIL(t_start + t_sched2);
     LWB_SEND_SCHED();    /* send the schedule for the next round */
     
     /* --- COMMUNICATION ROUND ENDS --- */
@@ -713,6 +1959,16 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
 #if LWB_CONF_STATS_NVMEM
     lwb_stats_save();
 #endif /* LWB_CONF_STATS_NVMEM */
+#if LWB_CONF_CHECKPOINT
+    if(++ckpt_cnt >= LWB_CONF_CHECKPOINT_INTERVAL) {
+      ckpt_cnt = 0;
+      lwb_sched_save(ckpt_addr);
+    } else {
+      /* keep the time up to date in each round, the network time must not 
+       * jump back after a restart (period without the 1st schedule flag) */
+      lwb_sched_ckpt_update(schedule.time, schedule.period & ~0x8000);
+    }
+#endif /* LWB_CONF_CHECKPOINT */
     /* poll the other processes to allow them to run after the LWB task was 
      * suspended (note: the polled processes will be executed in the inverse
      * order they were started/created) */
@@ -722,16 +1978,59 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
       process_poll(post_proc);    
     }
     
+#if LWB_CONF_BOOT_BEACON_INTERVAL
+    /* --- BOOTSTRAP BEACONS --- */
+    
+    /* send the header of the next schedule in regular intervals until the 
+     * next round starts (n_slots holds the number of remaining intervals) */
+    memcpy(glossy_payload.raw_data, &schedule, LWB_SCHED_PKT_HEADER_LEN);
+    LWB_SCHED_SET_AS_2ND((lwb_schedule_t*)glossy_payload.raw_data);
+    beacon_cnt = 0;
+    if(LWB_PERIOD_TO_TICKS(schedule.period, RTIMER_SECOND_HF) > 
+       (LWB_CONF_T_SCHED2_START + LWB_T_BEACON_MARGIN * 2)) {
+      rtimer_clock_t n = (LWB_PERIOD_TO_TICKS(schedule.period, 
+                                              RTIMER_SECOND_HF) -
+                          LWB_CONF_T_SCHED2_START - LWB_T_BEACON_MARGIN) / 
+                         LWB_T_BEACON_INTERVAL;
+      beacon_cnt = (n > 0x0fff) ? 0x0fff : (uint16_t)n;
+    }
+#if LWB_LF_CALIB
+    lwb_lf_calib_update();
+#endif /* LWB_LF_CALIB */
+    while(beacon_cnt && 
+          (beacon_cnt * LWB_T_BEACON_INTERVAL >= LWB_T_BEACON_MARGIN)) {
+      LWB_SCHED_SET_AS_BEACON((lwb_schedule_t*)glossy_payload.raw_data, 
+                              beacon_cnt);
+  #if LWB_CONF_USE_LF_FOR_WAKEUP
+      LWB_LF_WAIT_UNTIL(t_start_lf + 
+                        LWB_PERIOD_TO_TICKS(schedule.period, 
+                                            RTIMER_SECOND_LF) - 
+                        (rtimer_clock_t)beacon_cnt * 
+                        LWB_CONF_BOOT_BEACON_INTERVAL * RTIMER_SECOND_LF / 
+                        1000);
+      rt->time = rtimer_now_hf();
+  #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+      LWB_WAIT_UNTIL(t_start + 
+                     LWB_PERIOD_TO_TICKS(schedule.period, RTIMER_SECOND_HF) -
+                     beacon_cnt * LWB_T_BEACON_INTERVAL);
+  #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+      LWB_SEND_BEACON();
+      beacon_cnt--;
+    }
+#endif /* LWB_CONF_BOOT_BEACON_INTERVAL */
+    
     /* suspend this task and wait for the next round */
 #if LWB_CONF_USE_LF_FOR_WAKEUP
+  #if LWB_LF_CALIB
+    lwb_lf_calib_update();
+  #endif /* LWB_LF_CALIB */
     LWB_LF_WAIT_UNTIL(t_start_lf + 
-                      (rtimer_clock_t)schedule.period * RTIMER_SECOND_LF / 
-                      LWB_CONF_TIME_SCALE - LWB_CONF_T_PREPROCESS *
-                      RTIMER_SECOND_LF / 1000);
+                      LWB_PERIOD_TO_TICKS(schedule.period, RTIMER_SECOND_LF) -
+                      LWB_CONF_T_PREPROCESS * RTIMER_SECOND_LF / 1000 - 
+                      LWB_LF_SETTLE);
 #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
     LWB_WAIT_UNTIL(t_start + 
-                   (rtimer_clock_t)schedule.period * RTIMER_SECOND_HF /
-                   LWB_CONF_TIME_SCALE - 
+                   LWB_PERIOD_TO_TICKS(schedule.period, RTIMER_SECOND_HF) - 
                    LWB_CONF_T_PREPROCESS * RTIMER_SECOND_HF / 1000);
 #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
   }
@@ -740,6 +2039,169 @@ PT_THREAD(lwb_thread_host(rtimer_t *rt))
 }
 #endif /* LWB_CONF_RELAY_ONLY */
 /*---------------------------------------------------------------------------*/
+/* clock drift estimation (source node): scalar Kalman filter, the drift is 
+ * modelled as a random walk and each measured period between two received 
+ * schedules yields a sample; fixed point with LWB_DRIFT_FP fractional bits */
+#define LWB_DRIFT_FP              8
+#define LWB_DRIFT_VAR_INIT        ((uint32_t)LWB_CONF_MAX_CLOCK_DEV * \
+                                   LWB_CONF_MAX_CLOCK_DEV << LWB_DRIFT_FP)
+/* number of consecutive outliers after which the estimate is discarded */
+#define LWB_DRIFT_MAX_OUTLIERS    2
+
+static int32_t  drift_est = 0;                  /* estimated drift */
+static uint32_t drift_var = LWB_DRIFT_VAR_INIT; /* variance of the estimate */
+static uint8_t  drift_n_outliers = 0;
+/*---------------------------------------------------------------------------*/
+/* integer square root */
+static uint16_t
+lwb_isqrt(uint32_t x)
+{
+  uint32_t res = 0, bit = (uint32_t)1 << 30;
+  while(bit > x) {
+    bit >>= 2;
+  }
+  while(bit) {
+    if(x >= res + bit) {
+      x -= res + bit;
+      res = (res >> 1) + bit;
+    } else {
+      res >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint16_t)res;
+}
+/*---------------------------------------------------------------------------*/
+/* the estimate is kept (the drift of the local clock doesn't change), but 
+ * it can't be trusted anymore */
+static void
+lwb_drift_reset(void)
+{
+  drift_var = LWB_DRIFT_VAR_INIT;
+  drift_n_outliers = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* processes a drift sample (see LWB_CONF_MAX_CLOCK_DEV for the unit) that 
+ * has been measured over t_elapsed units of 1/LWB_CONF_PERIOD_SCALE seconds,
+ * returns the new estimate */
+static int32_t
+lwb_drift_update(int32_t sample, uint32_t t_elapsed)
+{
+  int32_t  innov;
+  uint32_t r, k;
+  uint64_t dev;
+  /* prediction: the uncertainty grows over time (64-bit, clamped) */
+  dev = drift_var + (uint64_t)LWB_CONF_DRIFT_PROC_NOISE * t_elapsed / 
+                    LWB_CONF_PERIOD_SCALE;
+  drift_var = (dev > LWB_DRIFT_VAR_INIT) ? LWB_DRIFT_VAR_INIT : (uint32_t)dev;
+  /* measurement noise: jitter of the two timestamps, relative to the length
+   * of the measured period (the longer the period, the better the sample) */
+  dev = ((uint64_t)LWB_CONF_DRIFT_T_REF_JITTER << LWB_DRIFT_FP) * 
+        LWB_CONF_PERIOD_SCALE / t_elapsed;
+  dev = (2 * dev * dev) >> LWB_DRIFT_FP;
+  r = (dev > LWB_DRIFT_VAR_INIT) ? LWB_DRIFT_VAR_INIT : (dev ? dev : 1);
+  innov = sample * (1 << LWB_DRIFT_FP) - drift_est;
+  /* discard outliers (more than 3 sigma off), unless they persist */
+  if(((uint64_t)((int64_t)innov * innov) >> LWB_DRIFT_FP) > 
+     9 * ((uint64_t)drift_var + r)) {
+    if(++drift_n_outliers < LWB_DRIFT_MAX_OUTLIERS) {
+      DEBUG_PRINT_VERBOSE("drift sample discarded (%ld)", sample);
+      return drift_est >> LWB_DRIFT_FP;
+    }
+    drift_var = LWB_DRIFT_VAR_INIT;   /* the drift has changed, start over */
+  }
+  drift_n_outliers = 0;
+  /* correction with the Kalman gain k = var / (var + r), Q16 */
+  k = ((uint64_t)drift_var << 16) / ((uint64_t)drift_var + r);
+  drift_est += (int32_t)(((int64_t)innov * k) >> 16);
+  drift_var = ((uint64_t)drift_var * (((uint32_t)1 << 16) - k)) >> 16;
+  stats.drift = drift_est >> LWB_DRIFT_FP;
+  stats.drift_dev = lwb_isqrt(drift_var) >> (LWB_DRIFT_FP / 2);
+  return drift_est >> LWB_DRIFT_FP;
+}
+/*---------------------------------------------------------------------------*/
+#if LWB_CONF_ADAPTIVE_GUARD
+/* converts a value in the unit of LWB_CONF_MAX_CLOCK_DEV into HF clock ticks */
+#if LWB_CONF_USE_LF_FOR_WAKEUP
+#define LWB_DRIFT_TO_HF_TICKS(x)  ((x) * RTIMER_HF_LF_RATIO / 256)
+#else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+#define LWB_DRIFT_TO_HF_TICKS(x)  (x)
+#endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+/* returns the guard time (in HF clock ticks) that covers the clock 
+ * uncertainty accumulated over t_ms milliseconds since the last received 
+ * schedule: 3 sigma of the predicted drift estimate (at most the max. clock 
+ * deviation) plus the timestamp jitter, clamped to [t_min, t_max] */
+static uint32_t
+lwb_guard_time(uint32_t t_ms, uint32_t t_min, uint32_t t_max)
+{
+  uint64_t var, dev;
+  var = drift_var + (uint64_t)LWB_CONF_DRIFT_PROC_NOISE * t_ms / 1000;
+  if(var > LWB_DRIFT_VAR_INIT) {
+    var = LWB_DRIFT_VAR_INIT;
+  }
+  /* std. deviation with LWB_DRIFT_FP / 2 fractional bits */
+  dev = 3 * (uint64_t)lwb_isqrt(var);
+  if(dev > ((uint64_t)LWB_CONF_MAX_CLOCK_DEV << (LWB_DRIFT_FP / 2))) {
+    dev = (uint64_t)LWB_CONF_MAX_CLOCK_DEV << (LWB_DRIFT_FP / 2);
+  }
+  dev = ((dev * t_ms / 1000) >> (LWB_DRIFT_FP / 2)) + 
+        3 * LWB_CONF_DRIFT_T_REF_JITTER;
+  dev = LWB_DRIFT_TO_HF_TICKS(dev);
+  if(dev < t_min) {
+    return t_min;
+  }
+  return (dev > t_max) ? t_max : (uint32_t)dev;
+}
+#endif /* LWB_CONF_ADAPTIVE_GUARD */
+/*---------------------------------------------------------------------------*/
+#if LWB_CONF_CHECKPOINT
+static void
+lwb_checkpoint_save(const lwb_schedule_t* sched, int32_t drift_last)
+{
+  lwb_checkpoint_t ckpt;
+  ckpt.crc        = 0;
+  ckpt.period     = sched->period & 0x7fff;
+  ckpt.time       = sched->time;
+  ckpt.drift_est  = drift_est;
+  ckpt.drift_var  = drift_var;
+  ckpt.drift_last = drift_last;
+  lwb_stream_export(ckpt.streams);
+  ckpt.crc = crc16((uint8_t*)&ckpt, sizeof(lwb_checkpoint_t), 0);
+  if(!xmem_write(ckpt_addr, sizeof(lwb_checkpoint_t), (uint8_t*)&ckpt)) {
+    DEBUG_PRINT_WARNING("failed to write the checkpoint");
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* restores the sync state and the streams, returns 0 if there is no valid
+ * checkpoint; the phase of the rounds is lost (the timers restart after a 
+ * reset), but the period and the drift of the local clock are still valid */
+static uint8_t
+lwb_checkpoint_load(lwb_schedule_t* sched, int32_t* drift_last)
+{
+  lwb_checkpoint_t ckpt;
+  uint16_t crc;
+  if(XMEM_ALLOC_ERROR == ckpt_addr ||
+     !xmem_read(ckpt_addr, sizeof(lwb_checkpoint_t), (uint8_t*)&ckpt)) {
+    return 0;
+  }
+  crc = ckpt.crc;
+  ckpt.crc = 0;
+  if(crc16((uint8_t*)&ckpt, sizeof(lwb_checkpoint_t), 0) != crc) {
+    DEBUG_PRINT_MSG_NOW("no valid checkpoint found");
+    return 0;
+  }
+  sched->period = ckpt.period;
+  sched->time   = ckpt.time;
+  drift_est     = ckpt.drift_est;
+  drift_var     = ckpt.drift_var;
+  *drift_last   = ckpt.drift_last;
+  lwb_stream_import(ckpt.streams);
+  DEBUG_PRINT_MSG_NOW("checkpoint loaded (t=%lu, %u streams)", ckpt.time, 
+                      lwb_joined_streams_cnt);
+  return 1;
+}
+#endif /* LWB_CONF_CHECKPOINT */
+/*---------------------------------------------------------------------------*/
 /**
  * @brief declaration of the protothread (source node)
  */
@@ -755,28 +2217,74 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
 #if LWB_CONF_USE_LF_FOR_WAKEUP
   static rtimer_clock_t t_ref_lf;
 #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
-#if LWB_CONF_TIME_SCALE == 1
   static rtimer_clock_t t_ref_last;
+#if !LWB_CONF_USE_LF_FOR_WAKEUP || LWB_LF_CALIB
+  /* fractional part of t_ref and t_ref_last (1/2^GLOSSY_T_REF_FP ticks, 
+   * 1/256 LF ticks with LWB_LF_CALIB) */
+  static uint8_t  t_ref_frac, t_ref_last_frac;
+#endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
   static int32_t  drift = 0;
-#endif /* LWB_CONF_TIME_SCALE == 1 */
-  static int32_t  drift_last = 0;  
+  static uint32_t t_elapsed;
+  static int32_t  drift_last = 0;           /* current drift estimate */
+  static uint8_t  t_ref_rcvd;      /* 1st schedule of this round received */
+  static uint8_t  t_ref_last_valid = 0;   /* t_ref_last is a measured ref */
   static uint32_t t_guard;                  /* 32-bit is enough for t_guard! */
+  static uint32_t t_sched2, t_sched2_win;   /* start of the 2nd schedule */
   static uint8_t  slot_idx;
+  static uint8_t  rounds_skipped = 0;   /* # rounds skipped before this one */
+#if LWB_CONF_RESYNC_ROUNDS
+  static uint8_t  resync_cnt = 0;     /* # rounds spent in the RESYNC state */
+#endif /* LWB_CONF_RESYNC_ROUNDS */
+  static rtimer_clock_t t_boot_lf;          /* start of the bootstrap */
+  static uint32_t t_boot_rx;                /* radio-on time during bootstrap */
+#if LWB_CONF_STANDBY_HOST_ID
+  static uint8_t  standby_missed = 0;   /* # rounds without a schedule */
+  static uint32_t standby_t_last;       /* time of the last 1st schedule */
+  static uint8_t  standby_heard;        /* flood heard in this round */
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+#if LWB_CONF_CHECKPOINT
+  static uint8_t  warm_start = 0;     /* state restored from the checkpoint */
+  static uint32_t t_warm;             /* time of the restored schedule */
+#endif /* LWB_CONF_CHECKPOINT */
+#if LWB_CONF_BOOT_SCAN
+  static rtimer_clock_t t_scan;             /* start of the current scan */
+  static rtimer_clock_t t_scan_len;         /* duration of the current scan */
+  static rtimer_clock_t t_scan_sleep;       /* sleep time between 2 scans */
+#endif /* LWB_CONF_BOOT_SCAN */
 #if !LWB_CONF_RELAY_ONLY
   static uint8_t  payload_len;
-  static uint8_t  rounds_to_wait = 0; 
+  static uint8_t* tx_pkt;                   /* message to send */
+  static uint8_t  srq_sent;      /* request piggybacked in this round */
+ #if LWB_VERSION == 1
+  static uint8_t  srq_id;
+  static uint8_t* rx_pkt;                   /* receive buffer for data */
+ #endif /* LWB_VERSION */
 #endif /* LWB_CONF_RELAY_ONLY */
   static int8_t   glossy_snr = 0;
+#if LWB_CONF_SYNC_STATS
+  static lwb_sync_rec_t sync_cur;           /* sync record of this round */
+  static rtimer_clock_t t_sync_exp;         /* expected start of the round */
+  static uint8_t  sync_rec_valid;
+#endif /* LWB_CONF_SYNC_STATS */
   static const void* callback_func = lwb_thread_src;
   
   PT_BEGIN(&lwb_pt);   /* declare variables before this statement! */
   
+#if LWB_CONF_STANDBY_HOST_ID
+  if(LWB_IS_STANDBY_HOST) {
+    lwb_sched_init(&schedule);      /* mirror of the host's stream table */
+  }
+#endif /* LWB_CONF_STANDBY_HOST_ID */
   memset(&schedule, 0, sizeof(schedule)); 
   
   /* initialization specific to the source node */
   lwb_stream_init();
   sync_state        = BOOTSTRAP;
   stats.period_last = LWB_CONF_SCHED_PERIOD_MIN;
+#if LWB_CONF_CHECKPOINT
+  warm_start = lwb_checkpoint_load(&schedule, &drift_last);
+  t_warm = schedule.time;
+#endif /* LWB_CONF_CHECKPOINT */
   
   while(1) {
       
@@ -795,19 +2303,101 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
     
     /* --- COMMUNICATION ROUND STARTS --- */
     
-#if LWB_CONF_USE_LF_FOR_WAKEUP
+#if LWB_LF_CALIB
+    if(sync_state != BOOTSTRAP) {
+      /* the timer fired LWB_CONF_LF_SETTLE early: convert the LF wake-up 
+       * time into an HF timestamp and wait on the HF timer */
+      rt->time = lwb_lf_anchor(rt->time + LWB_CONF_LF_SETTLE);
+      if(rt->time > rtimer_now_hf()) {
+        LWB_WAIT_UNTIL(rt->time);
+      }
+    } else {
+      rt->time = rtimer_now_hf();
+    }
+    t_ref = rt->time + t_guard;        /* in case the schedule is missed */
+#elif LWB_CONF_USE_LF_FOR_WAKEUP
     rt->time = rtimer_now_hf();        /* overwrite LF with HF timestamp */
     t_ref = rt->time + t_guard;        /* in case the schedule is missed */
 #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+#if LWB_CONF_SYNC_STATS
+    /* no expectation if the node is not synchronized */
+    sync_rec_valid = (sync_state != BOOTSTRAP);
+    t_sync_exp = rt->time + t_guard;
+    {
+      int64_t guard = LWB_TICKS_TO_US(t_guard);
+      sync_cur.guard = (guard > 0xffff) ? 0xffff : (uint16_t)guard;
+    }
+#endif /* LWB_CONF_SYNC_STATS */
     
     if(sync_state == BOOTSTRAP) {
       DEBUG_PRINT_MSG_NOW("BOOTSTRAP ");
       stats.bootstrap_cnt++;
-      drift_last = 0;
-      lwb_stream_rejoin();  /* rejoin all (active) streams */
+      t_ref_last_valid = 0;
+      rounds_skipped = 0;
+#if LWB_LF_CALIB
+      /* the HF clock is stopped in between the scans, no valid anchor */
+      calib_valid = 0;
+#endif /* LWB_LF_CALIB */
+      t_boot_lf = rtimer_now_lf();
+      t_boot_rx = 0;
+#if LWB_CONF_BOOT_SCAN
+      t_scan = rtimer_now_hf();
+      t_scan_len = LWB_T_SCAN;
+      t_scan_sleep = LWB_CONF_BOOT_SCAN_SLEEP_MIN;
+#endif /* LWB_CONF_BOOT_SCAN */
+#if LWB_CONF_CHECKPOINT
+      if(warm_start) {
+        /* keep the restored drift estimate and streams; the period is 
+         * known, scan for one full period to catch the next round */
+  #if LWB_CONF_BOOT_SCAN
+        t_scan_len += LWB_PERIOD_TO_TICKS(schedule.period, RTIMER_SECOND_HF);
+  #endif /* LWB_CONF_BOOT_SCAN */
+      } else
+#endif /* LWB_CONF_CHECKPOINT */
+      {
+        lwb_drift_reset();
+        lwb_stream_rejoin();  /* rejoin all (active) streams */
+      }
       /* synchronize first! wait for the first schedule... */
       do {
         LWB_RCV_SCHED();
+        t_boot_rx += LWB_CONF_T_SCHED + t_guard;
+#if LWB_CONF_BOOT_SCAN
+        if(glossy_is_t_ref_updated() && !LWB_SCHED_IS_1ST(&schedule)) {
+          /* 2nd schedule or beacon: sleep until shortly before the next 
+           * round (the 2nd schedule was sent at most T_SCHED2_START after 
+           * the start of its round) */
+  #if LWB_CONF_BOOT_BEACON_INTERVAL
+          if(LWB_SCHED_IS_BEACON(&schedule)) {
+            t_scan = LWB_SCHED_BEACON_CNT(&schedule) * LWB_T_BEACON_INTERVAL;
+          } else 
+  #endif /* LWB_CONF_BOOT_BEACON_INTERVAL */
+          {
+            t_scan = LWB_PERIOD_TO_TICKS(schedule.period, RTIMER_SECOND_HF) -
+                     LWB_CONF_T_SCHED2_START;
+          }
+          t_scan = glossy_get_t_ref() + t_scan - LWB_T_BOOT_GUARD(t_scan);
+          if(t_scan > rtimer_now_hf()) {
+            LWB_LF_WAIT_UNTIL(rtimer_now_lf() + 
+                              LWB_HF_TO_LF(t_scan - rtimer_now_hf()));
+            rt->time = rtimer_now_hf();
+          }
+          t_scan = rtimer_now_hf();
+        } else if((rtimer_now_hf() - t_scan) > t_scan_len) {
+          /* nothing received: sleep for a random time in [s/2, s] and 
+           * double s, up to the (last known) period */
+          LWB_LF_WAIT_UNTIL(rtimer_now_lf() + t_scan_sleep / 2 + 
+                            ((t_scan_sleep / 2 * random_rand()) >> 16));
+          rt->time = rtimer_now_hf();
+          t_scan = rt->time;
+          t_scan_len = LWB_T_SCAN;
+          t_scan_sleep <<= 1;
+          if(t_scan_sleep > LWB_T_SCAN_SLEEP_MAX(&schedule)) {
+            t_scan_sleep = LWB_T_SCAN_SLEEP_MAX(&schedule);
+          }
+        }
+#else /* LWB_CONF_BOOT_SCAN */
+        /* (with LWB_CONF_BOOT_SCAN, the scan sleep is capped instead) */
         if((rtimer_now_hf() - t_ref) > LWB_CONF_T_SILENT) {
           DEBUG_PRINT_MSG_NOW("communication timeout, going to sleep...");
           LWB_BEFORE_DEEPSLEEP();
@@ -816,12 +2406,30 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
           DEBUG_PRINT_MSG_NOW("BOOTSTRAP ");
           /* alternative: implement a host failover policy */
         }
+#endif /* LWB_CONF_BOOT_SCAN */
       } while(!glossy_is_t_ref_updated() || !LWB_SCHED_IS_1ST(&schedule));
       /* schedule received! */
       putchar('\r');
       putchar('\n');
+      stats.t_join = (rtimer_now_lf() - t_boot_lf) / RTIMER_SECOND_LF;
+      stats.t_join_rx = t_boot_rx / (RTIMER_SECOND_HF / 1000);
+      DEBUG_PRINT_INFO("joined after %us (radio on for %lums)", 
+                       stats.t_join, stats.t_join_rx);
+#if LWB_CONF_CHECKPOINT
+      if(warm_start && (schedule.time < t_warm)) {
+        /* the host has restarted without its stream table */
+        lwb_stream_rejoin();
+      }
+      warm_start = 0;
+#endif /* LWB_CONF_CHECKPOINT */
     } else {
+#if LWB_CONF_RESYNC_ROUNDS
+      /* when resynchronizing, listen for t_guard before and after the 
+       * expected start of the round */
+      LWB_RCV_SCHED_WINDOW((RESYNC == sync_state) ? t_guard : 0);
+#else /* LWB_CONF_RESYNC_ROUNDS */
       LWB_RCV_SCHED();  
+#endif /* LWB_CONF_RESYNC_ROUNDS */
     }
     glossy_snr = glossy_get_snr();
 
@@ -833,7 +2441,28 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
     /* update the sync state machine (compute new sync state and update 
      * t_guard) */
     LWB_UPDATE_SYNC_STATE;  
+#if LWB_CONF_RESYNC_ROUNDS
+    if(RESYNC == sync_state) {
+      /* keep the streams, but don't try forever */
+      if(resync_cnt >= LWB_CONF_RESYNC_ROUNDS) {
+        DEBUG_PRINT_WARNING("resync failed");
+        resync_cnt = 0;
+        sync_state = BOOTSTRAP;
+      } else {
+        resync_cnt++;
+      }
+    } else {
+      resync_cnt = 0;
+    }
+#endif /* LWB_CONF_RESYNC_ROUNDS */
+#if LWB_CONF_STANDBY_HOST_ID
+    /* the standby host doesn't bootstrap if the schedule was missed, it 
+     * either takes over at the end of this round or resynchronizes */
+    if(BOOTSTRAP == sync_state && 
+       (!LWB_IS_STANDBY_HOST || glossy_is_t_ref_updated())) {
+#else /* LWB_CONF_STANDBY_HOST_ID */
     if(BOOTSTRAP == sync_state) {
+#endif /* LWB_CONF_STANDBY_HOST_ID */
       /* something went wrong */
       continue;
     } 
@@ -841,35 +2470,104 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
     if(glossy_is_t_ref_updated()) {
       /* HF timestamp of first RX; subtract a constant offset */
       t_ref = glossy_get_t_ref() - LWB_CONF_T_REF_OFS;           
-  #if LWB_CONF_USE_LF_FOR_WAKEUP
+  #if LWB_LF_CALIB
+      /* estimate t_ref_lf (incl. the fractional part) by subtracting the 
+       * elapsed time since t_ref from the timestamp of an LF clock edge */
+      rtimer_clock_t hf_now;
+      uint64_t ofs;
+      lwb_lf_edge(&hf_now, &t_ref_lf);
+      ofs = ((uint64_t)(hf_now - t_ref) << 24) / hf_lf_ratio;
+      t_ref_lf -= (ofs + 255) >> 8;
+      t_ref_frac = (uint8_t)(-ofs);
+  #elif LWB_CONF_USE_LF_FOR_WAKEUP
       /* estimate t_ref_lf by subtracting the elapsed time since t_ref: */
       rtimer_clock_t hf_now;
       rtimer_now(&hf_now, &t_ref_lf);
       t_ref_lf -= (uint32_t)(hf_now - t_ref) / (uint32_t)RTIMER_HF_LF_RATIO;
+  #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+      t_ref_frac = glossy_get_t_ref_frac();
   #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
       global_time = schedule.time;
       reception_timestamp = t_ref;
+#if LWB_CONF_USE_LF_FOR_WAKEUP
+      lwb_set_time_ref(schedule.time, t_ref_lf, drift_last);
+#else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+      lwb_set_time_ref(schedule.time, t_ref, drift_last);
+#endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+      t_ref_rcvd = 1;
+#if LWB_CONF_SYNC_STATS
+      {
+        int32_t ofs = (int32_t)LWB_TICKS_TO_US((int32_t)(t_ref - t_sync_exp));
+        sync_cur.ofs = (ofs > 0x7fff) ? 0x7fff : 
+                       ((ofs < -0x7fff) ? -0x7fff : (int16_t)ofs);
+      }
+      sync_cur.relay_cnt = glossy_get_relay_cnt_first_rx();
+      sync_cur.snr = glossy_snr;
+#endif /* LWB_CONF_SYNC_STATS */
+#if LWB_CONF_STANDBY_HOST_ID
+      standby_missed = 0;
+      standby_t_last = schedule.time;
+#endif /* LWB_CONF_STANDBY_HOST_ID */
     } else {
+      t_ref_rcvd = 0;
+#if LWB_CONF_STANDBY_HOST_ID
+      standby_missed++;
+      standby_heard = 0;
+#endif /* LWB_CONF_STANDBY_HOST_ID */
       DEBUG_PRINT_WARNING("schedule missed");
       /* we can only estimate t_ref and t_ref_lf */
-      t_ref += schedule.period * (RTIMER_SECOND_HF + drift_last) /
-               LWB_CONF_TIME_SCALE; 
+      t_ref += LWB_PERIOD_TO_TICKS(LWB_T_NEXT_ROUND, 
+                                   RTIMER_SECOND_HF + drift_last); 
   #if LWB_CONF_USE_LF_FOR_WAKEUP
       /* since HF clock was off, we need a new timestamp; subtract a const.
        * processing offset to adjust (if needed) */
-      t_ref_lf += (schedule.period * RTIMER_SECOND_LF + 
-                  ((int32_t)schedule.period * drift_last >> 8)) /
-                  LWB_CONF_TIME_SCALE;
+      t_ref_lf += LWB_PERIOD_TO_TICKS(LWB_T_NEXT_ROUND, RTIMER_SECOND_LF) +
+                  (int64_t)LWB_T_NEXT_ROUND * drift_last / 
+                  (256 * LWB_CONF_PERIOD_SCALE);
   #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
       /* don't update schedule.time here! */
     }
+#if LWB_CONF_ADAPTIVE_GUARD
+    /* guard time for the slots and the 2nd schedule of this round: the 
+     * uncertainty builds up until the end of the round, starting from the 
+     * last received schedule */
+    if(t_ref_rcvd) {
+      t_guard = lwb_guard_time(LWB_CONF_T_SCHED2_START * 1000 / 
+                               RTIMER_SECOND_HF, LWB_CONF_T_GUARD_MIN, 
+                               LWB_CONF_T_GUARD_1);
+    } else {
+      t_guard = lwb_guard_time((t_elapsed + LWB_T_NEXT_ROUND) * 1000 / 
+                               LWB_CONF_PERIOD_SCALE + 
+                               LWB_CONF_T_SCHED2_START * 1000 / 
+                               RTIMER_SECOND_HF, LWB_CONF_T_GUARD_MIN, 
+                               LWB_T_GUARD_MAX);
+    }
+#endif /* LWB_CONF_ADAPTIVE_GUARD */
+    /* the 2nd schedule follows right after the last slot of this round; if
+     * the number of slots is unknown, listen until the latest possible 
+     * start (the schedule of a participating node is the one received at the
+     * end of the last round) */
+    if(glossy_is_t_ref_updated() || 
+       sync_state == SYNCED || sync_state == UNSYNCED) {
+      t_sched2 = LWB_T_SCHED2_START(&schedule);
+      t_sched2_win = 0;
+    } else {
+      t_sched2 = LWB_T_SCHED2_MIN;
+      t_sched2_win = LWB_CONF_T_SCHED2_START - LWB_T_SCHED2_MIN;
+    }
 
-    /* permission to participate in this round? */
-    if(sync_state == SYNCED || sync_state == UNSYNCED) {
+    /* permission to participate in this round? (the standby host keeps 
+     * listening in the slots of the last schedule after a missed schedule
+     * to find out whether the host is still active) */
+    if(sync_state == SYNCED || sync_state == UNSYNCED || 
+       LWB_STANDBY_LISTEN_ONLY) {
         
       static uint8_t i;  /* must be static */      
       slot_idx = 0;   /* reset the packet counter */
       stats.relay_cnt = glossy_get_relay_cnt_first_rx();     
+#if !LWB_CONF_RELAY_ONLY
+      srq_sent = 0;
+#endif /* LWB_CONF_RELAY_ONLY */
 #if LWB_CONF_SCHED_COMPRESS
       lwb_sched_uncompress((uint8_t*)schedule.slot, 
                            LWB_SCHED_N_SLOTS(&schedule));
@@ -881,6 +2579,7 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
         /* wait for the slot to start */
         LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(0) - t_guard);     
         LWB_RCV_PACKET();                 /* receive s-ack */
+        LWB_STANDBY_RX_CHECK;
   #if !LWB_CONF_RELAY_ONLY
         if(LWB_DATA_RCVD) {
           static uint8_t i; /* must be static */
@@ -894,7 +2593,9 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
               uint8_t stream_id = *(uint8_t*)(glossy_payload.raw_data + 
                                   (i * 4 + 2));
               stats.t_slot_last = schedule.time;
-              rounds_to_wait = 0;
+              if(stream_id == urgent_stream_req) {
+                urgent_stream_req = LWB_INVALID_STREAM_ID;
+              }
               if(lwb_stream_update_state(stream_id)) {
                 DEBUG_PRINT_INFO("S-ACK received for stream %u (joined)", 
                                  stream_id);
@@ -912,34 +2613,104 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
         slot_idx++;   /* increment the packet counter */
       }
       
+  #if LWB_CONF_DATA_ACK
+      /* --- D-ACK SLOT --- */
+      
+      if(LWB_SCHED_HAS_DACK_SLOT(&schedule)) {
+        LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx) - t_guard);
+        LWB_RCV_PACKET();                 /* receive d-ack */
+        LWB_STANDBY_RX_CHECK;
+    #if !LWB_CONF_RELAY_ONLY
+        /* does the D-ACK refer to the round in which we sent data? */
+        if(out_sent_n_slots && LWB_DATA_RCVD && 
+           glossy_get_payload_len() >= (LWB_DACK_PKT_HEADER_LEN + 
+                                        (out_sent_n_slots + 7) / 8) &&
+           glossy_payload.dack_pkt.time == out_sent_time) {
+          DEBUG_PRINT_VERBOSE("D-ACK received");
+          lwb_out_buffer_dack(glossy_payload.dack_pkt.bitmap);
+        }
+    #endif /* LWB_CONF_RELAY_ONLY */
+        slot_idx++;
+      }
+    #if !LWB_CONF_RELAY_ONLY
+      if(out_sent_n_slots) {
+        /* no D-ACK received for the messages sent in the last round */
+        lwb_out_buffer_dack(0);
+      }
+      out_sent_time = (uint16_t)schedule.time;
+      out_sent_n_slots = LWB_SCHED_N_SLOTS(&schedule);
+      memset(out_sent_slot, 0, out_sent_n_slots);
+    #endif /* LWB_CONF_RELAY_ONLY */
+  #endif /* LWB_CONF_DATA_ACK */
+      
       /* --- DATA SLOTS --- */
 
       if(LWB_SCHED_HAS_DATA_SLOT(&schedule)) {
         for(i = 0; i < LWB_SCHED_N_SLOTS(&schedule); i++, slot_idx++) {
   #if !LWB_CONF_RELAY_ONLY
-          if(schedule.slot[i] == node_id) {
+          if(schedule.slot[i] == node_id && !LWB_STANDBY_LISTEN_ONLY) {
             stats.t_slot_last = schedule.time;
             /* this is our data slot, send a data packet */
+    #if LWB_VERSION == 2
+            /* fetch the next 'ready-to-send' packet */
+            tx_pkt = lwb_out_buffer_get(glossy_payload.raw_data, 
+                                        &payload_len);
+    #else /* LWB_VERSION */
             payload_len = 0;
-            /* is there an 'urgent' stream request? -> if so, piggyback it 
-             * onto the data packet */
-            if(urgent_stream_req) {
-              glossy_payload.data_pkt.recipient = 0;
-              glossy_payload.data_pkt.stream_id = LWB_INVALID_STREAM_ID;
-              if(lwb_stream_prepare_req((lwb_stream_req_t*)
-                                        &glossy_payload.raw_data[3], 
-                                        urgent_stream_req)) {
-                payload_len = sizeof(lwb_stream_req_t) + 3;
-              }
-              DEBUG_PRINT_VERBOSE("piggyback stream request prepared");
+            tx_pkt = glossy_payload.raw_data;
+            /* is there an 'urgent' stream request? -> if so, send it instead
+             * of a data packet */
+            if(urgent_stream_req != LWB_INVALID_STREAM_ID) {
+              srq_id = urgent_stream_req;
             } else {
               /* fetch the next 'ready-to-send' packet */
-              payload_len = lwb_out_buffer_get(glossy_payload.raw_data);
+              tx_pkt = lwb_out_buffer_get(glossy_payload.raw_data, 
+                                          &payload_len);
+    #if LWB_CONF_PIGGYBACK_SRQ
+              /* any pending request? -> append it to the data packet (only
+               * once per round) */
+              srq_id = srq_sent ? LWB_INVALID_STREAM_ID : 
+                                  lwb_stream_get_pending();
+    #else /* LWB_CONF_PIGGYBACK_SRQ */
+              srq_id = LWB_INVALID_STREAM_ID;
+    #endif /* LWB_CONF_PIGGYBACK_SRQ */
             }
+            if(srq_id != LWB_INVALID_STREAM_ID) {
+              if(tx_pkt != glossy_payload.raw_data && (payload_len + 
+                 LWB_PIGGYBACK_SRQ_LEN) <= LWB_CONF_MAX_DATA_PKT_LEN) {
+                /* the message in the queue can't be extended, copy it to the
+                 * packet buffer */
+                memcpy(glossy_payload.raw_data, tx_pkt, payload_len);
+                tx_pkt = glossy_payload.raw_data;
+              }
+              if(!payload_len) {
+                /* the packet only carries the stream request */
+                LWB_PKT_SET_RECIPIENT(tx_pkt, LWB_RECIPIENT_HOST);
+                LWB_PKT_STREAM_ID(tx_pkt) = LWB_INVALID_STREAM_ID;
+                payload_len = LWB_DATA_PKT_HEADER_LEN;
+              }
+              payload_len = lwb_append_srq(tx_pkt, payload_len, srq_id);
+              if(LWB_PKT_STREAM_ID(tx_pkt) == LWB_INVALID_STREAM_ID &&
+                 payload_len == LWB_DATA_PKT_HEADER_LEN) {
+                payload_len = 0;               /* failed to prepare request */
+              } else if(LWB_PKT_HAS_SRQ(tx_pkt)) {
+                DEBUG_PRINT_VERBOSE("piggyback stream request prepared");
+                /* start the backoff as for a request in the contention 
+                 * slot, i.e. don't append it again in this round */
+                lwb_stream_req_sent(srq_id);
+                srq_sent = 1;
+              }
+            }
+    #endif /* LWB_VERSION */
             if(payload_len) {
               LWB_DATA_IND;
               LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx));
-              LWB_SEND_PACKET();
+              LWB_SEND_PACKET_FROM(tx_pkt);
+    #if LWB_CONF_DATA_ACK
+              lwb_out_buffer_sent(i);    /* keep it until it is acknowledged */
+    #else /* LWB_CONF_DATA_ACK */
+              lwb_out_buffer_release();      /* remove it from the queue */
+    #endif /* LWB_CONF_DATA_ACK */
               DEBUG_PRINT_INFO("data packet sent (%ub)", payload_len);
             } else {              
               DEBUG_PRINT_VERBOSE("no message to send (data slot ignored)");
@@ -950,21 +2721,43 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
             /* receive a data packet */
             LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx) - 
                            t_guard);
+  #if !LWB_CONF_RELAY_ONLY && LWB_VERSION == 1
+            rx_pkt = lwb_in_buffer_reserve(glossy_payload.raw_data);
+            LWB_RCV_PACKET_INTO(rx_pkt);
+  #else /* LWB_CONF_RELAY_ONLY */
+            /* note: in version 2, all data packets are sent to the host */
             LWB_RCV_PACKET();
+  #endif /* LWB_CONF_RELAY_ONLY */
             payload_len = glossy_get_payload_len();
-  #if !LWB_CONF_RELAY_ONLY
+            LWB_STANDBY_RX_CHECK;
+  #if !LWB_CONF_RELAY_ONLY && LWB_VERSION == 1
             /* process the received data */
             if(LWB_DATA_RCVD && payload_len) {
               /* measure the time it takes to process the received data */
               RTIMER_CAPTURE;     
+              /* drop stream requests of other nodes */
+              if(LWB_PKT_HAS_SRQ(rx_pkt)) {
+    #if LWB_CONF_STANDBY_HOST_ID
+                if(LWB_IS_STANDBY_HOST) {
+                  lwb_stream_req_t srq;                       /* mirror */
+                  payload_len = lwb_strip_srq(rx_pkt, payload_len, &srq);
+                  srq.id = schedule.slot[i];
+                  lwb_sched_proc_srq(&srq);
+                } else
+    #endif /* LWB_CONF_STANDBY_HOST_ID */
+                payload_len = lwb_strip_srq(rx_pkt, payload_len, 0);
+              }
               /* only forward packets that are destined for this node */
-              if(glossy_payload.data_pkt.recipient == node_id || 
-                glossy_payload.data_pkt.recipient == LWB_RECIPIENT_BROADCAST) {
+              if(payload_len &&
+                 (LWB_PKT_RECIPIENT(rx_pkt) == node_id || 
+                  LWB_PKT_RECIPIENT(rx_pkt) == LWB_RECIPIENT_BROADCAST)) {
                 DEBUG_PRINT_VERBOSE("data received");
                 /* replace target node ID by sender node ID */
-                glossy_payload.data_pkt.recipient = schedule.slot[i];
-                lwb_in_buffer_put(glossy_payload.raw_data, 
-                                  payload_len);
+                LWB_PKT_SET_RECIPIENT(rx_pkt, schedule.slot[i]);
+                if(lwb_in_buffer_put_pkt(rx_pkt, payload_len, 
+                                         glossy_payload.raw_data)) {
+                  LWB_RX_NOTIFY_APP;
+                }
               } else {
                 DEBUG_PRINT_VERBOSE("received packet dropped");      
               }
@@ -983,57 +2776,131 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
 
       /* is there a contention slot in this round? */
       if(LWB_SCHED_HAS_CONT_SLOT(&schedule)) {
+        static uint8_t j;           /* must be static */
+        static uint8_t minislot;
+        minislot = 0xff;                           /* no request to send */
   #if !LWB_CONF_RELAY_ONLY
         /* does this node have pending stream requests? */
-        if(LWB_STREAM_REQ_PENDING) {
-          if(!rounds_to_wait) {              /* allowed to send the request? */
-            /* try to join, send the stream request */
-            if(lwb_stream_prepare_req(&glossy_payload.srq_pkt, 
-                                      LWB_INVALID_STREAM_ID)) {
-      #if LWB_CONF_MAX_CONT_BACKOFF
-              /* wait between 1 and LWB_CONF_MAX_CONT_BACKOFF rounds */
-              rounds_to_wait = (random_rand() >> 1) % 
-                               LWB_CONF_MAX_CONT_BACKOFF + 1;
-      #endif /* LWB_CONF_MAX_CONT_BACKOFF */
-              payload_len = sizeof(lwb_stream_req_t);
-              /* wait until the contention slot starts */
-              LWB_REQ_IND;
-              LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx));
-              LWB_SEND_SRQ();  
-              DEBUG_PRINT_INFO("request for stream %u sent", 
-                               glossy_payload.srq_pkt.stream_id);
-            } else {
-              DEBUG_PRINT_ERROR("failed to prepare stream request packet");
-            }
+        if(LWB_STREAM_REQ_PENDING && !LWB_STANDBY_LISTEN_ONLY) {
+          lwb_stream_backoff();       /* one more contention slot has passed */
+          /* allowed to send a request? (streams that back off are skipped, 
+           * no request if one has been piggybacked in this round) */
+          if(!srq_sent && lwb_stream_prepare_req(&glossy_payload.srq_pkt, 
+                                                 LWB_INVALID_STREAM_ID)) {
+            /* pick one of the mini-slots at random */
+            minislot = (random_rand() >> 1) % LWB_CONF_CONT_N_MINISLOTS;
           } else {
-            DEBUG_PRINT_VERBOSE("must wait %u rounds", rounds_to_wait);
-            /* keep waiting and just relay incoming packets */
-            rounds_to_wait--;       /* decrease the number of rounds to wait */
-            /* wait until the contention slot starts */
-            LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx) - t_guard);  
-            LWB_RCV_SRQ();
+            DEBUG_PRINT_VERBOSE("backing off");
           }
           DEBUG_PRINT_VERBOSE("pending stream requests: 0x%x", 
                               LWB_STREAM_REQ_PENDING);
-        } else {
+        }
   #endif /* LWB_CONF_RELAY_ONLY */
-          /* no request pending -> just receive / relay packets */
-          LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx) - t_guard);
-          LWB_RCV_SRQ();
-                  
+        for(j = 0; j < LWB_CONF_CONT_N_MINISLOTS; j++) {
   #if !LWB_CONF_RELAY_ONLY
+          /* note: the packet buffer may have been overwritten in a previous
+           * mini-slot, therefore compose the request again */
+          if(j == minislot && 
+             lwb_stream_prepare_req(&glossy_payload.srq_pkt, 
+                                    LWB_INVALID_STREAM_ID)) {
+            payload_len = sizeof(lwb_stream_req_t);
+            /* wait until the mini-slot starts */
+            LWB_REQ_IND;
+            LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx) + 
+                           LWB_T_MINISLOT_START(j));
+            LWB_SEND_SRQ();  
+            lwb_stream_req_sent(glossy_payload.srq_pkt.stream_id);
+            DEBUG_PRINT_INFO("request for stream %u sent", 
+                             glossy_payload.srq_pkt.stream_id);
+            continue;
+          }
+  #endif /* LWB_CONF_RELAY_ONLY */
+          /* no request to send -> just receive / relay packets */
+          LWB_WAIT_UNTIL(t_ref + LWB_T_SLOT_START(slot_idx) + 
+                         LWB_T_MINISLOT_START(j) - t_guard);
+          LWB_RCV_SRQ();
+          LWB_STANDBY_RX_CHECK;
+  #if LWB_CONF_STANDBY_HOST_ID
+          if(LWB_IS_STANDBY_HOST && LWB_DATA_RCVD) {
+            lwb_sched_proc_srq(&glossy_payload.srq_pkt);      /* mirror */
+          }
+  #endif /* LWB_CONF_STANDBY_HOST_ID */
         }
-  #endif /* LWB_CONF_RELAY_ONLY */ 
       }
     }  
     
     /* --- 2ND SCHEDULE --- */
 
-    LWB_WAIT_UNTIL(t_ref + LWB_CONF_T_SCHED2_START - t_guard);
-    LWB_RCV_SCHED();
+    LWB_WAIT_UNTIL(t_ref + t_sched2 - t_guard);
+    LWB_RCV_SCHED_WINDOW(t_sched2_win);
   
     /* update the state machine and the guard time */
     LWB_UPDATE_SYNC_STATE;
+#if LWB_CONF_SYNC_STATS
+    if(sync_rec_valid) {
+      if(t_ref_rcvd) {
+        sync_cur.sched = 1;
+        /* offset larger than expected from the guard time? */
+        sync_cur.anomaly = (((sync_cur.ofs < 0) ? -(int32_t)sync_cur.ofs : 
+                             sync_cur.ofs) > 
+                            (int32_t)sync_cur.guard * LWB_CONF_SYNC_ANOMALY / 
+                            100);
+        if(sync_cur.anomaly) {
+          DEBUG_PRINT_WARNING("sync anomaly (ofs=%dus, guard=%uus)", 
+                              sync_cur.ofs, sync_cur.guard);
+        }
+      } else {
+        sync_cur.sched = glossy_is_t_ref_updated() ? 2 : 0;
+        sync_cur.anomaly = 0;
+        sync_cur.ofs = 0;
+        sync_cur.relay_cnt = 0;
+        sync_cur.snr = 0;
+      }
+      sync_cur.drift = (int16_t)LWB_DRIFT_TO_PPM(drift_last);
+      lwb_sync_stats_add(&sync_cur);
+    }
+#endif /* LWB_CONF_SYNC_STATS */
+#if LWB_CONF_STANDBY_HOST_ID
+    if(LWB_IS_STANDBY_HOST) {
+      if(glossy_is_t_ref_updated()) {
+        standby_missed = 0;
+      } else if(standby_missed && standby_heard) {
+        /* the other nodes are still active, i.e. only the link to the host 
+         * is down: don't count this round and resynchronize instead */
+        standby_missed = 0;
+        DEBUG_PRINT_VERBOSE("host not heard, but network active");
+      } else if(standby_missed && 
+                (standby_missed >= LWB_CONF_STANDBY_TAKEOVER || 
+                 BOOTSTRAP == sync_state)) {
+        /* no schedule from the host: take over and start the next round 
+         * at the time the nodes expect it */
+        DEBUG_PRINT_MSG_NOW("host lost, taking over");
+        standby_time = standby_t_last + t_elapsed + LWB_T_NEXT_ROUND + 
+                       schedule.period;
+        standby_period = schedule.period;
+        standby_active = 1;
+  #if LWB_CONF_USE_LF_FOR_WAKEUP
+        rtimer_schedule(LWB_CONF_LF_RTIMER_ID, t_ref_lf + 
+                        LWB_PERIOD_TO_TICKS(schedule.period, 
+                                            RTIMER_SECOND_LF) +
+                        (int64_t)schedule.period * drift_last / 
+                        (256 * LWB_CONF_PERIOD_SCALE) -
+                        LWB_CONF_T_PREPROCESS * RTIMER_SECOND_LF / 1000 - 
+                        LWB_LF_SETTLE, 0, lwb_thread_host);
+  #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+        rtimer_schedule(LWB_CONF_RTIMER_ID, t_ref + 
+                        LWB_PERIOD_TO_TICKS(schedule.period, 
+                                            RTIMER_SECOND_HF + drift_last) -
+                        LWB_CONF_T_PREPROCESS * RTIMER_SECOND_HF / 1000, 
+                        0, lwb_thread_host);
+  #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+        LWB_TASK_SUSPENDED;
+        PT_EXIT(&lwb_pt);
+      }
+      /* the S-ACKs are sent by the host */
+      lwb_sched_prepare_sack(glossy_payload.raw_data);
+    }
+#endif /* LWB_CONF_STANDBY_HOST_ID */
     if(BOOTSTRAP == sync_state) {
       continue;
     }
@@ -1051,19 +2918,57 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
     }
 #endif /* !LWB_CONF_RELAY_ONLY */
     
-    /* estimate the clock drift */
-#if (LWB_CONF_TIME_SCALE == 1)  /* only calc drift if time scale is not used */
+    /* estimate the clock drift (in clock ticks per second, independent of 
+     * the period length) */
+    /* elapsed time since the last measured reference (incl. the skipped and
+     * missed rounds) */
+    t_elapsed += (uint32_t)stats.period_last * (1 + rounds_skipped);
+    if(t_ref_rcvd) {
+      if(t_ref_last_valid) {
+  #if LWB_LF_CALIB
+        /* t_ref can't be used in this case -> use t_ref_lf instead (incl.
+         * the fractional parts) */
+        drift = (int32_t)(((int64_t)((t_ref_lf - t_ref_last) - 
+                           LWB_PERIOD_TO_TICKS(t_elapsed, RTIMER_SECOND_LF)) *
+                           256 + t_ref_frac - t_ref_last_frac) * 
+                          LWB_CONF_PERIOD_SCALE / (int32_t)t_elapsed);
+  #elif LWB_CONF_USE_LF_FOR_WAKEUP
+        /* t_ref can't be used in this case -> use t_ref_lf instead */
+        drift = (int32_t)((int64_t)((t_ref_lf - t_ref_last) - 
+                           LWB_PERIOD_TO_TICKS(t_elapsed, RTIMER_SECOND_LF)) * 
+                          (256 * LWB_CONF_PERIOD_SCALE) / (int32_t)t_elapsed);
+  #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+        /* incl. the fractional parts of the timestamps */
+        drift = (int32_t)(((int64_t)((t_ref - t_ref_last) - 
+                           LWB_PERIOD_TO_TICKS(t_elapsed, RTIMER_SECOND_HF)) *
+                           (1 << GLOSSY_T_REF_FP) + t_ref_frac - 
+                           t_ref_last_frac) * LWB_CONF_PERIOD_SCALE / 
+                          ((int64_t)t_elapsed << GLOSSY_T_REF_FP));
+  #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+        if((drift < LWB_CONF_MAX_CLOCK_DEV) && 
+           (drift > -LWB_CONF_MAX_CLOCK_DEV)) {
+          drift_last = lwb_drift_update(drift, t_elapsed);
+        } else {
+          /* most probably a timer update overrun or a host failure
+           * usually, the deviation per second is not higher than 50 cycles;
+           * if only one timer update is missed in 30 seconds, the deviation 
+           * per second is still more than 1k cycles and therefore 
+           * detectable */
+          DEBUG_PRINT_WARNING("Critical timing error, d=%ld", drift);
+        }
+      }
   #if LWB_CONF_USE_LF_FOR_WAKEUP
-    /* t_ref can't be used in this case -> use t_ref_lf instead */
-    drift = ((int32_t)((t_ref_lf - t_ref_last) - ((int32_t)stats.period_last *
-                       RTIMER_SECOND_LF)) << 8) / (int32_t)stats.period_last;
-    t_ref_last = t_ref_lf;     
+      t_ref_last = t_ref_lf;
+    #if LWB_LF_CALIB
+      t_ref_last_frac = t_ref_frac;
+    #endif /* LWB_LF_CALIB */
   #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
-    drift = (int32_t)((t_ref - t_ref_last) - ((int32_t)stats.period_last *
-                      RTIMER_SECOND_HF)) / (int32_t)stats.period_last;
-    t_ref_last = t_ref; 
+      t_ref_last = t_ref;
+      t_ref_last_frac = t_ref_frac;
   #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
-#endif /* LWB_CONF_TIME_SCALE */
+      t_ref_last_valid = 1;
+      t_elapsed = 0;
+    }
     
     stats.period_last = schedule.period;
     if(sync_state > SYNCED_2) {
@@ -1089,24 +2994,67 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
 #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
                      glossy_get_per(),
                      glossy_snr);
-#if (LWB_CONF_TIME_SCALE == 1)
-    if(sync_state <= MISSED) {
-      if((drift < LWB_CONF_MAX_CLOCK_DEV) && 
-         (drift > -LWB_CONF_MAX_CLOCK_DEV)) {
-        drift_last = (drift_last + drift) / 2;
-      } else if(drift_last) {  /* only if not zero */
-        /* most probably a timer update overrun or a host failure
-         * usually, the deviation per second is not higher than 50 cycles; 
-         * if only one timer update is missed in 30 seconds, the deviation per
-         * second is still more than 1k cycles and therefore detectable */
-        DEBUG_PRINT_WARNING("Critical timing error, d=%ld", drift);
+
+#if LWB_CONF_SCHED_LOOKAHEAD && !LWB_CONF_RELAY_ONLY
+    /* no data slot in the next rounds? -> skip these rounds as long as the 
+     * accumulated clock deviation stays within the budget */
+    rounds_skipped = 0;
+    if(SYNCED_2 == sync_state && !LWB_STREAM_REQ_PENDING
+  #if LWB_CONF_DATA_ACK
+       /* the D-ACK for the messages sent in this round comes in the next 
+        * round, don't skip it */
+       && !lwb_out_buffer_dack_pending()
+  #endif /* LWB_CONF_DATA_ACK */
+       ) {
+      rounds_skipped = lwb_sched_plan_lookup((uint8_t*)&schedule, 
+                                             glossy_get_payload_len(), 
+                                             node_id);
+      while(rounds_skipped && 
+  #if LWB_CONF_ADAPTIVE_GUARD
+            (lwb_guard_time(LWB_T_NEXT_ROUND * 1000 / LWB_CONF_PERIOD_SCALE,
+                            0, 0xffffffff) > LWB_CONF_SKIP_DRIFT_BUDGET)) {
+  #else /* LWB_CONF_ADAPTIVE_GUARD */
+            (LWB_T_SKIP_DEV(rounds_skipped, schedule.period) > 
+             LWB_CONF_SKIP_DRIFT_BUDGET)) {
+  #endif /* LWB_CONF_ADAPTIVE_GUARD */
+        rounds_skipped--;
+      }
+      if(rounds_skipped) {
+  #if !LWB_CONF_ADAPTIVE_GUARD
+        /* widen the guard time for the next schedule */
+        t_guard += LWB_T_SKIP_DEV(rounds_skipped, schedule.period);
+  #endif /* LWB_CONF_ADAPTIVE_GUARD */
+        DEBUG_PRINT_VERBOSE("no slot, skipping %u rounds", rounds_skipped);
       }
     }
-#endif
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+
+#if LWB_CONF_ADAPTIVE_GUARD
+    /* guard time for the next schedule (incl. the skipped rounds) */
+    t_guard = lwb_guard_time((t_elapsed + LWB_T_NEXT_ROUND) * 1000 / 
+                             LWB_CONF_PERIOD_SCALE, LWB_CONF_T_GUARD_MIN, 
+                             LWB_T_GUARD_MAX);
+#elif LWB_CONF_RESYNC_ROUNDS
+    if(RESYNC == sync_state) {
+      /* widen the guard time by the residual clock deviation accumulated 
+       * since the last received schedule */
+      t_guard += LWB_PERIOD_TO_TICKS(t_elapsed + LWB_T_NEXT_ROUND, 
+                                     LWB_CONF_SKIP_RESIDUAL_DEV);
+      if(t_guard > LWB_CONF_RESYNC_T_GUARD_MAX) {
+        t_guard = LWB_CONF_RESYNC_T_GUARD_MAX;
+      }
+    }
+#endif /* LWB_CONF_ADAPTIVE_GUARD */
 
 #if LWB_CONF_STATS_NVMEM
     lwb_stats_save();
 #endif /* LWB_CONF_STATS_NVMEM */
+#if LWB_CONF_CHECKPOINT
+    if(t_ref_rcvd && (++ckpt_cnt >= LWB_CONF_CHECKPOINT_INTERVAL)) {
+      ckpt_cnt = 0;
+      lwb_checkpoint_save(&schedule, drift_last);
+    }
+#endif /* LWB_CONF_CHECKPOINT */
     /* erase the schedule (slot allocations only) */
     memset(&schedule.slot, 0, sizeof(schedule.slot));
 
@@ -1119,17 +3067,21 @@ PT_THREAD(lwb_thread_src(rtimer_t *rt))
     }
     
 #if LWB_CONF_USE_LF_FOR_WAKEUP
+  #if LWB_LF_CALIB
+    lwb_lf_calib_update();
+  #endif /* LWB_LF_CALIB */
     LWB_LF_WAIT_UNTIL(t_ref_lf + 
-                      ((rtimer_clock_t)schedule.period * RTIMER_SECOND_LF + 
-                       ((int32_t)schedule.period * drift_last / 256)) /
-                      LWB_CONF_TIME_SCALE - 
-                      t_guard / (uint32_t)RTIMER_HF_LF_RATIO - 
-                      LWB_CONF_T_PREPROCESS * RTIMER_SECOND_LF / 1000);
+                      LWB_PERIOD_TO_TICKS(LWB_T_NEXT_ROUND, RTIMER_SECOND_LF) +
+                      (int64_t)LWB_T_NEXT_ROUND * drift_last / 
+                      (256 * LWB_CONF_PERIOD_SCALE) - 
+                      LWB_HF_TO_LF(t_guard) - 
+                      LWB_CONF_T_PREPROCESS * RTIMER_SECOND_LF / 1000 - 
+                      LWB_LF_SETTLE);
 #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
     LWB_WAIT_UNTIL(t_ref + 
-                   (rtimer_clock_t)schedule.period *
-                   (RTIMER_SECOND_HF + drift_last) / 
-                   LWB_CONF_TIME_SCALE - t_guard - 
+                   LWB_PERIOD_TO_TICKS(LWB_T_NEXT_ROUND, 
+                                       RTIMER_SECOND_HF + drift_last) - 
+                   t_guard - 
                    LWB_CONF_T_PREPROCESS * RTIMER_SECOND_HF / 1000);
 #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
   }
@@ -1174,19 +3126,20 @@ PROCESS_THREAD(lwb_process, ev, data)
 #if LWB_CONF_STATS_NVMEM
   lwb_stats_load();   /* load the stats from the external memory */
 #endif /* LWB_CONF_STATS_NVMEM */
+#if LWB_CONF_CHECKPOINT
+  /* always allocated at this point, i.e. at the same address after a reset */
+  ckpt_addr = xmem_alloc(MAX(sizeof(lwb_checkpoint_t), LWB_SCHED_CKPT_SIZE));
+#endif /* LWB_CONF_CHECKPOINT */
   
 #if !LWB_CONF_RELAY_ONLY
  #if !LWB_CONF_USE_XMEM
   /* pass the start addresses of the memory blocks holding the queues */
-  fifo_init(&in_buffer, (uint16_t)in_buffer_mem);
-  fifo_init(&out_buffer, (uint16_t)out_buffer_mem); 
+  bfifo_init(&in_buffer, (uint16_t)in_buffer_mem);
  #else  /* LWB_CONF_USE_XMEM */
   /* allocate memory for the message buffering (in ext. memory) */
-  fifo_init(&in_buffer, xmem_alloc(LWB_CONF_IN_BUFFER_SIZE * 
-                                   (LWB_CONF_MAX_DATA_PKT_LEN + 1)));
-  fifo_init(&out_buffer, xmem_alloc(LWB_CONF_OUT_BUFFER_SIZE * 
-                                    (LWB_CONF_MAX_DATA_PKT_LEN + 1)));   
+  bfifo_init(&in_buffer, xmem_alloc(LWB_CONF_IN_BUFFER_BYTES));
  #endif /* LWB_CONF_USE_XMEM */
+  lwb_out_buffer_init();
 #endif /* LWB_CONF_RELAY_ONLY */
   
 #ifdef LWB_CONF_TASK_ACT_PIN
@@ -1201,6 +3154,17 @@ PROCESS_THREAD(lwb_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+uint8_t
+lwb_register_rx_proc(void *rx_lwb_proc)
+{
+#if LWB_RX_NOTIFY
+  rx_proc = (struct process*)rx_lwb_proc;
+  return 1;
+#else /* LWB_RX_NOTIFY */
+  return 0;
+#endif /* LWB_RX_NOTIFY */
+}
+/*---------------------------------------------------------------------------*/
 void
 lwb_start(void (*pre_lwb_func)(void), void *post_lwb_proc)
 {
@@ -1219,11 +3183,10 @@ lwb_start(void (*pre_lwb_func)(void), void *post_lwb_proc)
          LWB_CONF_MAX_DATA_SLOTS, 
          LWB_CONF_TX_CNT_DATA, 
          LWB_CONF_MAX_HOPS);  
-  if((LWB_CONF_T_SCHED2_START > RTIMER_SECOND_HF / LWB_CONF_TIME_SCALE)) {
-    printf("WARNING: LWB_CONF_T_SCHED2_START > 1s\r\n");
+  if((LWB_CONF_T_SCHED2_START + LWB_CONF_T_SCHED) > 
+     LWB_PERIOD_TO_TICKS(LWB_CONF_SCHED_PERIOD_MIN, RTIMER_SECOND_HF)) {
+    printf("WARNING: LWB_CONF_SCHED_PERIOD_MIN is too short\r\n");
   }
   process_start(&lwb_process, NULL);
 }
 /*---------------------------------------------------------------------------*/
-
-#endif /* LWB_VERSION */
\ No newline at end of file
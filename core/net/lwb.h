@@ -60,6 +60,13 @@
 #define LWB_VERSION     1       /* default version */
 #endif /* LWB_VERSION */
 
+/* version 2 is a lean protocol mode: the data packets don't have a header, 
+ * i.e. all messages are sent to the host and each node has a single stream 
+ * (the stream ID of a stream request is set to LWB_DEFAULT_STREAM_ID) */
+#if LWB_VERSION != 1 && LWB_VERSION != 2
+#error "unsupported LWB_VERSION"
+#endif
+
 /*---------------------------------------------------------------------------*/
 
 #ifndef LWB_CONF_MAX_DATA_PKT_LEN
@@ -67,7 +74,8 @@
  * determines T_Slot (LWB_CONF_T_DATA) and influences the power dissipation, 
  * choose as small as possible; must be <= (LWB_CONF_MAX_PKT_LEN - 5) 
  * NOTE: LWB_CONF_MAX_DATA_PKT_LEN must not exceed LWB_CONF_MAX_PKT_LEN
- * and the max. data payload length is LWB_CONF_MAX_DATA_PKT_LEN - 3 */
+ * and the max. data payload length is LWB_CONF_MAX_DATA_PKT_LEN - 3 
+ * (LWB_CONF_MAX_DATA_PKT_LEN in LWB_VERSION 2) */
 #define LWB_CONF_MAX_DATA_PKT_LEN       LWB_CONF_MAX_PKT_LEN
 #endif /* LWB_CONF_MAX_DATA_PKT_LEN */
 
@@ -88,13 +96,26 @@
 #define LWB_CONF_SKIP_QUASI_SYNCED      0
 #endif /* LWB_CONF_SKIP_QUASI_SYNCED */
 
-/* scaling factor to enable periods and IPIs of less than 1 second 
- * (e.g. a scale 10 means the LWB runs 10x faster, i.e. a round period of 1s
- * will effectively only be 100ms long) */
-#ifndef LWB_CONF_TIME_SCALE
-#define LWB_CONF_TIME_SCALE             1
+/* LWB_CONF_TIME_SCALE is deprecated, it is mapped onto LWB_CONF_PERIOD_SCALE;
+ * note: explicitly configured periods and IPIs keep their meaning, but the
+ * default periods (LWB_CONF_SCHED_PERIOD_MIN/MAX/IDLE) are now given in 
+ * seconds and scaled, e.g. with a scale of 5 the default max. period changes
+ * from 6s to 30s */
+#ifdef LWB_CONF_TIME_SCALE
+#warning "LWB_CONF_TIME_SCALE deprecated, default periods are now scaled"
+#ifndef LWB_CONF_PERIOD_SCALE
+#define LWB_CONF_PERIOD_SCALE           LWB_CONF_TIME_SCALE
+#endif /* LWB_CONF_PERIOD_SCALE */
 #endif /* LWB_CONF_TIME_SCALE */
 
+/* number of time units per second: the round period, the IPIs and the 
+ * network time are expressed in units of 1/LWB_CONF_PERIOD_SCALE seconds 
+ * (e.g. with a scale of 64, a period of 16 corresponds to 250ms); should be a
+ * power of 2, the drift compensation works for any value */
+#ifndef LWB_CONF_PERIOD_SCALE
+#define LWB_CONF_PERIOD_SCALE           1
+#endif /* LWB_CONF_PERIOD_SCALE */
+
 /* if set to 1, source nodes will only relay packets, but never receive 
  * (= store in internal memory for further processing) or transmit 
  * (= generate) packets, and therefore require less memory */
@@ -102,8 +123,8 @@
 #define LWB_CONF_RELAY_ONLY             0
 #endif /* LWB_CONF_RELAY_ONLY */
 
-#if !LWB_CONF_TIME_SCALE
-#error "invalid value for LWB_CONF_TIME_SCALE"
+#if !LWB_CONF_PERIOD_SCALE
+#error "invalid value for LWB_CONF_PERIOD_SCALE"
 #endif
 
 #ifndef LWB_CONF_USE_XMEM
@@ -120,6 +141,20 @@
 #define LWB_CONF_USE_LF_FOR_WAKEUP      0
 #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
 
+#ifndef LWB_CONF_LF_CALIB
+/* only with LWB_CONF_USE_LF_FOR_WAKEUP: wake up LWB_CONF_LF_SETTLE earlier, 
+ * re-anchor the HF timer at an edge of the LF clock and start the round on 
+ * the HF timer; the ratio between the HF and the LF clock is calibrated in 
+ * each round; opt-in, disabled by default */
+#define LWB_CONF_LF_CALIB               0
+#endif /* LWB_CONF_LF_CALIB */
+
+#ifndef LWB_CONF_LF_SETTLE
+/* time for the HF clock to settle after the wake-up from LPM3, in LF clock 
+ * ticks (only used with LWB_CONF_LF_CALIB) */
+#define LWB_CONF_LF_SETTLE              (RTIMER_SECOND_LF / 1000)
+#endif /* LWB_CONF_LF_SETTLE */
+
 /* error checking: can only use LFXT for wakeup if it's available on the PCB */
 #if LWB_CONF_USE_LF_FOR_WAKEUP && !CLOCK_CONF_XT1_ON
 #error "Can't use LF for wakeup (LWB)"
@@ -171,19 +206,67 @@
 #define LWB_CONF_T_GUARD_3              (RTIMER_SECOND_HF / 100)    /* 10 ms */
 #endif /* LWB_CONF_T_GUARD_3 */
 
+#ifndef LWB_CONF_ADAPTIVE_GUARD
+/* compute the guard times each round from the uncertainty of the clock drift
+ * estimate and the time since the last received schedule instead of using 
+ * the fixed guard time of the current sync state (source nodes only); 
+ * disabled by default, the fixed guard times are the safe choice */
+#define LWB_CONF_ADAPTIVE_GUARD         0
+#endif /* LWB_CONF_ADAPTIVE_GUARD */
+
+#ifndef LWB_CONF_T_GUARD_MIN
+/* lower bound for the adaptive guard times, covers the jitter of the Glossy 
+ * start and the processing delays: 0.1 ms */
+#define LWB_CONF_T_GUARD_MIN            (RTIMER_SECOND_HF / 10000)
+#endif /* LWB_CONF_T_GUARD_MIN */
+
+#ifndef LWB_CONF_T_GUARD_MAX
+/* upper bound for the adaptive guard time of the schedule */
+#define LWB_CONF_T_GUARD_MAX            LWB_CONF_T_GUARD_3
+#endif /* LWB_CONF_T_GUARD_MAX */
+
 #ifndef LWB_CONF_IN_BUFFER_SIZE         
-/* size (#elements) of the internal data buffer/queue for incoming messages,
- * should be at least LWB_CONF_MAX_DATA_SLOTS */
+/* size (#messages of max. length) of the internal data buffer/queue for 
+ * incoming messages, should be at least LWB_CONF_MAX_DATA_SLOTS */
 #define LWB_CONF_IN_BUFFER_SIZE         LWB_CONF_MAX_DATA_SLOTS
 #endif /* LWB_CONF_IN_BUFFER_SIZE */
 
 #ifndef LWB_CONF_OUT_BUFFER_SIZE         
-/* size (#elements) of the internal data buffer/queue for outgoing messages */
+/* size (#messages of max. length) of the internal data buffer/queue for 
+ * outgoing messages */
 #define LWB_CONF_OUT_BUFFER_SIZE        3
 #endif /* LWB_CONF_IN_BUFFER_SIZE */
 
+#ifndef LWB_CONF_IN_BUFFER_BYTES
+/* size in bytes of the incoming queue; messages only occupy their actual 
+ * length + 1 byte, by default the queue can hold at least 
+ * LWB_CONF_IN_BUFFER_SIZE messages of max. length */
+#define LWB_CONF_IN_BUFFER_BYTES        (LWB_CONF_IN_BUFFER_SIZE * \
+                                         (LWB_CONF_MAX_DATA_PKT_LEN + 1))
+#endif /* LWB_CONF_IN_BUFFER_BYTES */
+
+#ifndef LWB_CONF_OUT_BUFFER_BYTES
+/* size in bytes of the outgoing queue */
+#define LWB_CONF_OUT_BUFFER_BYTES       (LWB_CONF_OUT_BUFFER_SIZE * \
+                                         (LWB_CONF_MAX_DATA_PKT_LEN + 1))
+#endif /* LWB_CONF_OUT_BUFFER_BYTES */
+
+#ifndef LWB_CONF_OUT_N_QUEUES
+/* number of outgoing queues, each queue gets an equal share of 
+ * LWB_CONF_OUT_BUFFER_BYTES; messages of stream s are put into queue 
+ * (s % LWB_CONF_OUT_N_QUEUES) and a data slot is used for the queue whose 
+ * stream is due first (according to its IPI), i.e. a bursty stream can't
+ * consume the slots assigned to another stream */
+#define LWB_CONF_OUT_N_QUEUES           1
+#endif /* LWB_CONF_OUT_N_QUEUES */
+
 /* ensure that the buffer can at least hold one data packet */
-#if !LWB_CONF_IN_BUFFER_SIZE || !LWB_CONF_OUT_BUFFER_SIZE
+#if !LWB_CONF_IN_BUFFER_SIZE || !LWB_CONF_OUT_BUFFER_SIZE || \
+    !LWB_CONF_OUT_N_QUEUES || \
+    LWB_CONF_IN_BUFFER_BYTES < (LWB_CONF_MAX_DATA_PKT_LEN + 1) || \
+    (LWB_CONF_OUT_BUFFER_BYTES / LWB_CONF_OUT_N_QUEUES) < \
+    (LWB_CONF_MAX_DATA_PKT_LEN + 1) || \
+    LWB_CONF_IN_BUFFER_BYTES > 0xffff || LWB_CONF_OUT_BUFFER_BYTES > 0xffff
 #error "invalid LWB buffer size configuration!"
 #endif 
 
@@ -192,6 +275,62 @@
 #define LWB_CONF_STATS_NVMEM            0         
 #endif /* LWB_CONF_STATS_NVMEM */
 
+#ifndef LWB_CONF_SYNC_STATS               /* set to 0 to disable this feature */
+/* number of rounds for which the sync quality of a source node is recorded
+ * (see lwb_get_sync_stats) */
+#define LWB_CONF_SYNC_STATS             0
+#endif /* LWB_CONF_SYNC_STATS */
+
+#ifndef LWB_CONF_SYNC_ANOMALY
+/* a round is flagged as anomaly if the offset between the expected and the
+ * actual start of the round exceeds this percentage of the guard time */
+#define LWB_CONF_SYNC_ANOMALY           50
+#endif /* LWB_CONF_SYNC_ANOMALY */
+
+#if LWB_CONF_SYNC_STATS > 255
+#error "LWB_CONF_SYNC_STATS must not exceed 255"
+#endif
+
+#ifndef LWB_CONF_CHECKPOINT
+/* keep a checkpoint of the sync state and the stream table (source node) or
+ * the stream table of the scheduler (host) in the external memory to allow
+ * a warm restart after a reset; requires LWB_CONF_USE_XMEM */
+#define LWB_CONF_CHECKPOINT             0
+#endif /* LWB_CONF_CHECKPOINT */
+
+#ifndef LWB_CONF_CHECKPOINT_INTERVAL
+/* number of rounds between two checkpoints (the host updates the time of 
+ * its checkpoint in every round) */
+#define LWB_CONF_CHECKPOINT_INTERVAL    4
+#endif /* LWB_CONF_CHECKPOINT_INTERVAL */
+
+#if LWB_CONF_CHECKPOINT && !LWB_CONF_USE_XMEM
+#error "LWB_CONF_CHECKPOINT requires LWB_CONF_USE_XMEM"
+#endif
+
+#ifndef LWB_CONF_STANDBY_HOST_ID        /* set to 0 to disable this feature */
+/* ID of the standby host: this source node mirrors the stream table of the
+ * host from the overheard stream requests and takes over as host when the
+ * host fails (no schedule and no other flood heard for 
+ * LWB_CONF_STANDBY_TAKEOVER rounds); note: the standby host doesn't step 
+ * down by itself, it remains the host until it is reset. The failed host 
+ * must therefore not restart as host while the standby host is active (e.g.
+ * restart it with a different node ID or reset the standby host first) */
+#define LWB_CONF_STANDBY_HOST_ID        0
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+
+#ifndef LWB_CONF_STANDBY_TAKEOVER
+/* the standby host takes over after this number of consecutive rounds
+ * without a schedule and without any other flood (earlier if it would fall 
+ * back to the bootstrap) */
+#define LWB_CONF_STANDBY_TAKEOVER       3
+#endif /* LWB_CONF_STANDBY_TAKEOVER */
+
+#if LWB_CONF_STANDBY_HOST_ID && \
+    (LWB_CONF_RELAY_ONLY || LWB_CONF_STANDBY_HOST_ID == HOST_ID)
+#error "invalid LWB_CONF_STANDBY_HOST_ID"
+#endif
+
 #ifndef LWB_CONF_MAX_PKT_LEN
 /* the max. length of a packet (limits the message size as well as the max. 
  * size of a LWB packet and the schedule); do not change this value before
@@ -218,7 +357,8 @@
 
 #ifndef LWB_CONF_T_SILENT               /* set to 0 to disable this feature */
 /* if no communication happens within this time (i.e. no schedule received),
- * the source node goes into deepsleep mode for LWB_CONF_T_DEEPSLEEP LF ticks*/
+ * the source node goes into deepsleep mode for LWB_CONF_T_DEEPSLEEP LF ticks
+ * (only without LWB_CONF_BOOT_SCAN) */
 #define LWB_CONF_T_SILENT               (180 * RTIMER_SECOND_HF)
 #endif /* LWB_CONF_T_SILENT */
 
@@ -226,6 +366,39 @@
 #define LWB_CONF_T_DEEPSLEEP            (RTIMER_SECOND_LF * 3600)      /* 1h */
 #endif /* LWB_CONF_T_DEEPSLEEP */
 
+#ifndef LWB_CONF_BOOT_SCAN             /* set to 0 to listen continuously */
+/* duty-cycled scanning during bootstrap: listen for a little longer than 
+ * one round, then sleep (the sleep time is doubled after each unsuccessful
+ * scan, up to the length of the last known or the idle period); a received 
+ * 2nd schedule or beacon tells when the next round starts */
+#define LWB_CONF_BOOT_SCAN              1
+#endif /* LWB_CONF_BOOT_SCAN */
+
+#ifndef LWB_CONF_BOOT_SCAN_SLEEP_MIN
+/* initial sleep time between two scans, in LF clock ticks: 1 s */
+#define LWB_CONF_BOOT_SCAN_SLEEP_MIN    RTIMER_SECOND_LF
+#endif /* LWB_CONF_BOOT_SCAN_SLEEP_MIN */
+
+#ifndef LWB_CONF_BOOT_BEACON_INTERVAL   /* set to 0 to disable this feature */
+/* the host sends a short beacon (header of the next schedule) every 
+ * LWB_CONF_BOOT_BEACON_INTERVAL milliseconds between two rounds to help 
+ * joining nodes find the next round; must be the same on all nodes */
+#define LWB_CONF_BOOT_BEACON_INTERVAL   0
+#endif /* LWB_CONF_BOOT_BEACON_INTERVAL */
+
+#ifndef LWB_CONF_RESYNC_ROUNDS          /* set to 0 to disable this feature */
+/* max. number of rounds a source node tries to resynchronize (listening 
+ * around the expected start of the round with a widened guard time) after 
+ * it has lost the schedule before it falls back to a full bootstrap; the 
+ * streams are kept during the resynchronization */
+#define LWB_CONF_RESYNC_ROUNDS          3
+#endif /* LWB_CONF_RESYNC_ROUNDS */
+
+#ifndef LWB_CONF_RESYNC_T_GUARD_MAX
+/* upper bound for the guard time during the resynchronization: 50 ms */
+#define LWB_CONF_RESYNC_T_GUARD_MAX     (RTIMER_SECOND_HF / 20)
+#endif /* LWB_CONF_RESYNC_T_GUARD_MAX */
+
 #ifndef LWB_CONF_T_SCHED2_START
 /* start point (offset) of the second schedule at the end of a round
  * must be after LWB_T_ROUND_MAX; this ensures that the host node has at least
@@ -234,6 +407,22 @@
 #define LWB_CONF_T_SCHED2_START         LWB_T_ROUND_MAX
 #endif /* LWB_CONF_T_SCHED2_START */
 
+#ifndef LWB_CONF_SCHED2_EARLY
+/* send the second schedule right after the last slot of the round instead of
+ * at LWB_CONF_T_SCHED2_START (the position is given by the number of slots 
+ * announced in the first schedule, LWB_CONF_T_SCHED2_START is the latest 
+ * possible start) */
+#define LWB_CONF_SCHED2_EARLY           1
+#endif /* LWB_CONF_SCHED2_EARLY */
+
+#ifndef LWB_CONF_T_SCHED2_MARGIN
+/* with LWB_CONF_SCHED2_EARLY: time between the end of the last slot and the
+ * 2nd schedule, reserved for the host to process the stream requests and to
+ * compute the next schedule (in HF clock ticks, must exceed the computation
+ * time, see stats.t_sched_max) */
+#define LWB_CONF_T_SCHED2_MARGIN        (RTIMER_SECOND_HF / 50)    /* 20ms */
+#endif /* LWB_CONF_T_SCHED2_MARGIN */
+
 #ifndef LWB_CONF_T_PREPROCESS
 /* in milliseconds, set this to 0 to disable preprocessing before a LWB round*/
 #define LWB_CONF_T_PREPROCESS           0
@@ -248,6 +437,51 @@
   #define LWB_CONF_MAX_CLOCK_DEV        500     /* HF clock ticks */
  #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
 #endif /* LWB_CONF_MAX_CLOCK_DEV */
+#if LWB_CONF_MAX_CLOCK_DEV > 4095
+#error "LWB_CONF_MAX_CLOCK_DEV is too high"
+#endif
+
+#ifndef LWB_CONF_DRIFT_T_REF_JITTER
+/* jitter (std. deviation) of the reference timestamp taken upon reception of 
+ * the schedule, in the unit of LWB_CONF_MAX_CLOCK_DEV (without 'per second');
+ * determines the weight of a new sample in the clock drift estimation */
+ #if LWB_CONF_USE_LF_FOR_WAKEUP
+  #if LWB_CONF_LF_CALIB
+  /* the LF timestamp is derived from the HF timestamp (calibrated ratio) */
+  #define LWB_CONF_DRIFT_T_REF_JITTER   16
+  #else /* LWB_CONF_LF_CALIB */
+  #define LWB_CONF_DRIFT_T_REF_JITTER   256     /* 1 LF clock tick */
+  #endif /* LWB_CONF_LF_CALIB */
+ #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+  /* HF clock ticks (sub-tick resolution with GLOSSY_CONF_T_REF_AVG) */
+  #define LWB_CONF_DRIFT_T_REF_JITTER   1
+ #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+#endif /* LWB_CONF_DRIFT_T_REF_JITTER */
+
+#ifndef LWB_CONF_DRIFT_PROC_NOISE
+/* expected change of the clock drift over time (e.g. due to temperature 
+ * changes): variance increase per second, in (unit of LWB_CONF_MAX_CLOCK_DEV)^2
+ * / 256; the higher this value, the faster the drift estimation adapts */
+ #if LWB_CONF_USE_LF_FOR_WAKEUP
+  #define LWB_CONF_DRIFT_PROC_NOISE     48
+ #else /* LWB_CONF_USE_LF_FOR_WAKEUP */
+  #define LWB_CONF_DRIFT_PROC_NOISE     8
+ #endif /* LWB_CONF_USE_LF_FOR_WAKEUP */
+#endif /* LWB_CONF_DRIFT_PROC_NOISE */
+
+#ifndef LWB_CONF_SKIP_DRIFT_BUDGET
+/* max. clock deviation (in HF clock ticks) a source node may accumulate while 
+ * it skips rounds in which it has no data slot (only relevant if 
+ * LWB_CONF_SCHED_LOOKAHEAD is enabled); the guard time for the next schedule
+ * is widened accordingly */
+#define LWB_CONF_SKIP_DRIFT_BUDGET      LWB_CONF_T_GUARD_2
+#endif /* LWB_CONF_SKIP_DRIFT_BUDGET */
+
+#ifndef LWB_CONF_SKIP_RESIDUAL_DEV
+/* the remaining clock deviation after drift compensation, in HF clock ticks 
+ * per second (default: approx. 10 ppm) */
+#define LWB_CONF_SKIP_RESIDUAL_DEV      (RTIMER_SECOND_HF / 100000)
+#endif /* LWB_CONF_SKIP_RESIDUAL_DEV */
 
 #ifndef LWB_CONF_RTIMER_ID
 /* ID of the rtimer used for the LWB, must be of type rtimer_t */
@@ -269,16 +503,54 @@
 #define LWB_CONF_MAX_N_STREAMS          32 
 #endif /* N_STREAMS_MAX */
 
-/* max. number of rounds a node backs off after sending a stream request 
- * before it tries again */
+/* max. number of contention slots a node backs off after sending a stream 
+ * request before it tries again (upper bound for the binary exponential 
+ * backoff window), set to 0 to disable the backoff */
 #ifndef LWB_CONF_MAX_CONT_BACKOFF
 #define LWB_CONF_MAX_CONT_BACKOFF       8
 #endif /* LWB_CONF_MAX_CONT_BACKOFF */
 
+#if LWB_CONF_MAX_CONT_BACKOFF > 253
+#error "LWB_CONF_MAX_CONT_BACKOFF must not exceed 253"
+#endif
+
+#ifndef LWB_CONF_PIGGYBACK_SRQ
+/* append pending stream requests to data packets if there is space left; 
+ * bit 7 of the stream ID is used as flag, i.e. only stream IDs < 0x80 can be
+ * used for data packets if enabled (not supported in LWB_VERSION 2) */
+#define LWB_CONF_PIGGYBACK_SRQ          (LWB_VERSION == 1)
+#endif /* LWB_CONF_PIGGYBACK_SRQ */
+
+#if LWB_VERSION == 2 && (LWB_CONF_PIGGYBACK_SRQ || LWB_CONF_OUT_N_QUEUES > 1)
+#error "LWB_VERSION 2 supports neither piggybacking nor multiple out queues"
+#endif
+
+#ifndef LWB_CONF_CONT_N_MINISLOTS
+/* number of mini-slots (each of length LWB_CONF_T_CONT) per contention slot;
+ * a node with a pending stream request picks one of them at random */
+#define LWB_CONF_CONT_N_MINISLOTS       1
+#endif /* LWB_CONF_CONT_N_MINISLOTS */
+
+#if !LWB_CONF_CONT_N_MINISLOTS
+#error "LWB_CONF_CONT_N_MINISLOTS must be at least 1"
+#endif
+
 #ifndef LWB_CONF_DATA_ACK
+/* data acknowledgements: the host floods a bitmap of the data packets it 
+ * received in a round in the D-ACK slot of the next round; a source keeps 
+ * its messages in the outgoing queue until they have been acknowledged and
+ * retransmits them otherwise */
 #define LWB_CONF_DATA_ACK               0
 #endif /* LWB_CONF_DATA_ACK */
 
+#ifndef LWB_CONF_AGGREGATE
+/* packet aggregation: several queued messages for the same recipient are 
+ * sent in one data packet, each message preceded by a sub-header (length and
+ * stream ID, only the length in LWB_VERSION 2); the stream ID 
+ * LWB_AGGR_STREAM_ID is reserved for aggregated packets */
+#define LWB_CONF_AGGREGATE              0
+#endif /* LWB_CONF_AGGREGATE */
+
 /*---------------------------------------------------------------------------*/
 
 #ifndef RF_CONF_TX_POWER                /* set the radio antenna gain */
@@ -309,7 +581,13 @@
                                       LWB_CONF_DATA_ACK) * \
                                      (LWB_CONF_T_DATA + LWB_CONF_T_GAP) + \
                                      (LWB_CONF_T_SCHED + LWB_CONF_T_GAP) + \
-                                     (LWB_CONF_T_CONT + LWB_CONF_T_GAP))
+                                     (LWB_CONF_T_CONT + LWB_CONF_T_GAP) * \
+                                     LWB_CONF_CONT_N_MINISLOTS)
+
+/* converts a period or a time in units of 1/LWB_CONF_PERIOD_SCALE seconds 
+ * into clock ticks of a timer that runs at 'f' Hz */
+#define LWB_PERIOD_TO_TICKS(p, f)   ((rtimer_clock_t)(p) * (f) / \
+                                     LWB_CONF_PERIOD_SCALE)
 
 /* min. duration of 1 packet transmission with glossy (approx. values, taken 
  * from TelosB platform measurements) -> for 127b packets ~4.5ms, for 50b 
@@ -332,6 +610,15 @@
 #define LWB_RECIPIENT_GROUP_MASK    0xf000  /* group ID mask */
 #define LWB_RECIPIENT_NODE_MASK     0x0fff  /* node ID mask */
 
+/* length of the data packet header (recipient and stream ID) */
+#if LWB_VERSION == 2
+#define LWB_DATA_PKT_HEADER_LEN     0
+#define LWB_DEFAULT_STREAM_ID       1   /* the stream ID of all nodes */
+#else /* LWB_VERSION */
+#define LWB_DATA_PKT_HEADER_LEN     3
+#define LWB_AGGR_STREAM_ID          0x7e  /* marks an aggregated packet */
+#endif /* LWB_VERSION */
+
 /*---------------------------------------------------------------------------*/
 
 #define MAX(x, y)                   ((x) > (y) ? (x) : (y))
@@ -342,18 +629,51 @@
  */
 typedef struct {
     uint8_t  relay_cnt;
-    uint8_t  period_last;
     uint8_t  unsynced_cnt;
-    uint8_t  bootstrap_cnt;
+    uint16_t period_last; /* in units of 1/LWB_CONF_PERIOD_SCALE seconds */
+    uint16_t bootstrap_cnt;
     uint16_t reset_cnt;
     uint16_t pck_cnt;     /* total number of received packets */
     uint16_t t_sched_max; /* max. time needed to calculate the new schedule */
     uint16_t t_proc_max;  /* max. time needed to process the rcvd data pkts */
+    int16_t  drift;       /* estimated clock drift (LWB_CONF_MAX_CLOCK_DEV) */
+    uint16_t drift_dev;   /* uncertainty (std. deviation) of the estimate */
+    uint16_t t_join;      /* duration of the last bootstrap, in seconds */
     uint16_t crc;         /* crc of this struct (with crc set to 0!) */
-    uint32_t t_slot_last; /* last slot assignment (in seconds) */
+    uint32_t t_slot_last; /* last slot assignment (network time) */
     uint32_t data_tot;
+    uint32_t t_join_rx;   /* radio-on time of the last bootstrap, in ms */
 } lwb_statistics_t;
 
+#if LWB_CONF_SYNC_STATS
+/**
+ * @brief summary of the sync quality over the last LWB_CONF_SYNC_STATS 
+ * rounds (source node only)
+ * The offset is the difference between the expected and the actual start of 
+ * a round (measured on the 1st schedule). Offset, relay count and SNR are
+ * taken from the rounds in which the 1st schedule was received, guard time 
+ * and drift from all recorded rounds.
+ */
+typedef struct {
+    uint8_t  n_rounds;    /* number of recorded rounds */
+    uint8_t  n_sched1;    /* rounds synced on the 1st schedule */
+    uint8_t  n_sched2;    /* rounds synced on the 2nd schedule only */
+    uint8_t  n_anomalies; /* rounds with an offset > LWB_CONF_SYNC_ANOMALY */
+    uint16_t ofs_p50;     /* absolute offset in us, 50th percentile */
+    uint16_t ofs_p90;     /* absolute offset in us, 90th percentile */
+    uint16_t ofs_max;     /* max. absolute offset in us */
+    uint16_t guard_p50;   /* guard time in us, 50th percentile */
+    uint16_t guard_max;   /* max. guard time in us */
+    int16_t  drift_min;   /* min. clock drift estimate in ppm */
+    int16_t  drift_p50;   /* clock drift estimate in ppm, 50th percentile */
+    int16_t  drift_max;   /* max. clock drift estimate in ppm */
+    uint8_t  relay_p50;   /* relay count of the first RX, 50th percentile */
+    uint8_t  relay_max;   /* max. relay count of the first RX */
+    int8_t   snr_p10;     /* SNR in dB, 10th percentile */
+    int8_t   snr_p50;     /* SNR in dB, 50th percentile */
+} lwb_sync_stats_t;
+#endif /* LWB_CONF_SYNC_STATS */
+
 /**
  * @brief simplified 'connection state' of a source node
  * When a source node first boots, it is in LWB_STATE_INIT state. The node 
@@ -383,6 +703,19 @@ typedef enum {
  */
 void lwb_start(void (*pre_lwb_func)(void), void *post_lwb_proc);
 
+/**
+ * @brief register a process that is polled as soon as a message has been
+ * stored in the incoming queue (i.e. right after the data slot instead of 
+ * at the end of the round)
+ * @param rx_lwb_proc a pointer to the process control block (struct 
+ * process) or 0 to disable the notification
+ * @return 1 if successful, 0 if not supported (LWB_CONF_USE_XMEM)
+ * @note the process runs while the round is still ongoing (keep it short),
+ * a message passed to lwb_put_data() is sent in the next data slot of this
+ * node
+ */
+uint8_t lwb_register_rx_proc(void *rx_lwb_proc);
+
 
 /**
  * @brief pause the LWB by stopping the rtimer
@@ -406,7 +739,8 @@ lwb_conn_state_t lwb_get_state(void);
  * @param data a pointer to the data packet to send
  * @param len the length of the data packet (must be less or equal 
  * LWB_CONF_MAX_PKT_LEN)
- * @return 1 if successful, 0 otherwise (queue full)
+ * @return 1 if successful, 0 otherwise (queue full or invalid stream ID, 
+ * see LWB_CONF_PIGGYBACK_SRQ)
  */
 #if LWB_VERSION == 2
 uint8_t lwb_put_data(const uint8_t * const data, 
@@ -418,6 +752,89 @@ uint8_t lwb_put_data(uint16_t recipient,
                      uint8_t len);
 #endif
 
+/**
+ * @brief reserve the next free element in the outgoing queue to compose a 
+ * data packet in place (avoids copying the payload)
+ * @param recipient the target node ID
+ * @param stream_id the stream ID
+ * @return a pointer to the payload (max. LWB_CONF_MAX_DATA_PKT_LEN - 
+ * LWB_DATA_PKT_HEADER_LEN bytes, not necessarily aligned) or 0 if the queue 
+ * is full, the stream ID is invalid or another reservation is still open
+ * @note call lwb_commit_data() to insert the packet into the queue; only 
+ * one reservation can be open at a time (also blocks lwb_put_data() and 
+ * lwb_put_data_batch())
+ */
+#if LWB_VERSION == 2
+uint8_t* lwb_reserve_data(void);
+#else
+uint8_t* lwb_reserve_data(uint16_t recipient, uint8_t stream_id);
+#endif
+
+/**
+ * @brief insert the packet composed in the buffer obtained from 
+ * lwb_reserve_data() into the outgoing queue
+ * @param len the payload length in bytes
+ * @return 1 if successful, 0 otherwise
+ * @note the reservation is released in any case
+ */
+uint8_t lwb_commit_data(uint8_t len);
+
+/* buffer layout for lwb_put_data_batch() and lwb_get_data_batch(): one 
+ * message per LWB_BATCH_STRIDE bytes, the payload starts at offset 
+ * LWB_DATA_PKT_HEADER_LEN */
+#define LWB_BATCH_STRIDE                (LWB_CONF_MAX_DATA_PKT_LEN + 1)
+#define LWB_BATCH_PAYLOAD(buf, k)       ((buf) + (uint16_t)(k) * \
+                                         LWB_BATCH_STRIDE + \
+                                         LWB_DATA_PKT_HEADER_LEN)
+
+/**
+ * @brief schedule several packets of the same stream for transmission
+ * @param recipient the target node ID
+ * @param stream_id the stream ID
+ * @param buf the messages, the payload of the k-th message is located at 
+ * LWB_BATCH_PAYLOAD(buf, k); note: the content of the buffer is modified 
+ * by this function
+ * @param len array with the payload length of each message
+ * @param n number of messages
+ * @return the number of messages that have been inserted into the queue 
+ * (0 while a reservation is open, see lwb_reserve_data())
+ */
+#if LWB_VERSION == 2
+uint8_t lwb_put_data_batch(uint8_t* buf,
+                           const uint8_t* len,
+                           uint8_t n);
+#else
+uint8_t lwb_put_data_batch(uint16_t recipient,
+                           uint8_t stream_id,
+                           uint8_t* buf,
+                           const uint8_t* len,
+                           uint8_t n);
+#endif
+
+/**
+ * @brief get several of the received data packets at once
+ * @param out_buf buffer of at least n * LWB_BATCH_STRIDE bytes, the payload
+ * of the k-th message is located at LWB_BATCH_PAYLOAD(out_buf, k)
+ * @param n max. number of messages to fetch
+ * @param out_len array of n elements, receives the payload lengths
+ * @param out_node_id array of n elements, receives the IDs of the nodes that
+ * sent the messages (optional parameter, pass 0 if not interested)
+ * @param out_stream_id array of n elements, receives the stream IDs 
+ * (optional parameter, pass 0 if not interested)
+ * @return the number of messages copied into out_buf
+ */
+#if LWB_VERSION == 2
+uint8_t lwb_get_data_batch(uint8_t* out_buf,
+                           uint8_t n,
+                           uint8_t* out_len);
+#else
+uint8_t lwb_get_data_batch(uint8_t* out_buf,
+                           uint8_t n,
+                           uint8_t* out_len,
+                           uint16_t * const out_node_id,
+                           uint8_t * const out_stream_id);
+#endif
+
 /** 
  * @brief get a data packet that have been received during the previous LWB
  * rounds
@@ -439,6 +856,31 @@ uint8_t lwb_get_data(uint8_t* out_data,
                      uint8_t * const out_stream_id);
 #endif
 
+/**
+ * @brief access the oldest received data packet without copying it, the 
+ * packet remains in the internal buffer until lwb_release_data() is called
+ * @param out_len the payload length in bytes (optional parameter, pass 0 if 
+ * not interested in this data)
+ * @param out_node_id the ID of the node that sent the message (optional)
+ * @param out_stream_id the stream ID (optional)
+ * @return a pointer to the payload or 0 if the queue is empty
+ * @note the payload is not necessarily aligned; if LWB_CONF_USE_XMEM is 
+ * enabled, the returned buffer is only valid until the next call of 
+ * lwb_put_data(), lwb_get_data() or lwb_peek_data()
+ */
+#if LWB_VERSION == 2
+const uint8_t* lwb_peek_data(uint8_t * const out_len);
+#else
+const uint8_t* lwb_peek_data(uint8_t * const out_len,
+                             uint16_t * const out_node_id, 
+                             uint8_t * const out_stream_id);
+#endif
+
+/**
+ * @brief remove the packet obtained with lwb_peek_data() from the buffer
+ */
+void lwb_release_data(void);
+
 /**
  * @brief check the status of the receive buffer (incoming messages)
  * @return 1 if there is at least 1 message in the queue, 0 otherwise
@@ -461,6 +903,8 @@ uint8_t lwb_get_send_buffer_state(void);
  * @note: the stream info data to which stream_request points will be copied
  * into an internal buffer and may be deleted after calling 
  * lwb_request_stream().
+ * @note: in LWB_VERSION 2, the stream ID is set to LWB_DEFAULT_STREAM_ID and 
+ * the parameter urgent has no effect.
  */
 uint8_t lwb_request_stream(lwb_stream_req_t* stream_request, uint8_t urgent);
 
@@ -474,14 +918,45 @@ const lwb_statistics_t * const lwb_get_stats(void);
  */
 void lwb_stats_reset(void);
 
+#if LWB_CONF_SYNC_STATS
+/**
+ * @brief get a summary of the sync quality over the last rounds
+ * @param out buffer for the summary
+ * @return the number of recorded rounds (0 if nothing has been recorded yet
+ * or the node is the host)
+ */
+uint8_t lwb_get_sync_stats(lwb_sync_stats_t* out);
+#endif /* LWB_CONF_SYNC_STATS */
+
 /**
  * @brief get the time of the LWB, i.e. the network-wide scheduler time 
  * @param reception_time timestamp of the reception of the last schedule,
  * optional parameter (pass 0 if not needed)
  * @return the relative time in seconds since the host started
+ * @note the network time is kept in units of 1/LWB_CONF_PERIOD_SCALE seconds,
+ * the return value is rounded down to full seconds
  */
 uint32_t lwb_get_time(rtimer_clock_t* reception_time);
 
+/**
+ * @brief get the current network time with microsecond resolution
+ * @return the time in microseconds since the host started
+ * @note the time is derived from the start of the last round and the local
+ * clock (drift compensated); it is only accurate if the node is connected.
+ * Can be called from an interrupt service routine.
+ */
+uint64_t lwb_get_time_us(void);
+
+/**
+ * @brief convert a timestamp of the local HF clock into network time
+ * @param hf_timestamp timestamp of the HF rtimer (e.g. rtimer_now_hf())
+ * @return the network time in microseconds that corresponds to hf_timestamp
+ * @note if the LF clock is used for the wake-up, the HF clock may be stopped
+ * in between the rounds: the timestamp must have been taken after the last 
+ * wake-up of the MCU. Can be called from an interrupt service routine.
+ */
+uint64_t lwb_timestamp_from_rtimer(rtimer_clock_t hf_timestamp);
+
 
 #endif /* __LWB_H__ */
 
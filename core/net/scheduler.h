@@ -57,10 +57,38 @@
 #define LWB_CONF_SCHED_T_NO_REQ              LWB_CONF_SCHED_PERIOD_MIN * 2
 #endif /* LWB_CONF_SCHED_T_NO_REQ */
 
+#ifndef LWB_CONF_SCHED_T_CONT_MAX
+/* max. time between two contention slots, i.e. the max. join latency (only 
+ * used by schedulers which adapt the number of contention slots to the 
+ * request rate, such as the min-energy scheduler) */
+#define LWB_CONF_SCHED_T_CONT_MAX            LWB_CONF_SCHED_PERIOD_MAX
+#endif /* LWB_CONF_SCHED_T_CONT_MAX */
+
+#ifndef LWB_CONF_SCHED_CONT_BURST
+/* number of rounds with a contention slot after a host reboot or a detected
+ * topology change */
+#define LWB_CONF_SCHED_CONT_BURST            10
+#endif /* LWB_CONF_SCHED_CONT_BURST */
+
 #ifndef LWB_CONF_SCHED_COMPRESS
 #define LWB_CONF_SCHED_COMPRESS              1
 #endif /* LWB_CONF_SCHED_COMPRESS */
 
+#ifndef LWB_CONF_SCHED_LOOKAHEAD
+/* number of rounds the host plans ahead (max. 255); if not zero, a 'next slot
+ * in k rounds' hint for each node is appended to the schedule and source 
+ * nodes without a slot may skip the following rounds (the round period is 
+ * kept constant within this horizon); with LWB_CONF_DATA_ACK, a node does
+ * not skip the round after it has sent data (it carries the D-ACK); set to 0
+ * to disable this feature */
+#define LWB_CONF_SCHED_LOOKAHEAD             0
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+
+#ifndef LWB_CONF_SCHED_PLAN_MAX_ENTRIES
+/* max. number of nodes listed in the slot plan of a schedule */
+#define LWB_CONF_SCHED_PLAN_MAX_ENTRIES      8
+#endif /* LWB_CONF_SCHED_PLAN_MAX_ENTRIES */
+
 /* --- defines for the HOST --- */
 
 #ifndef LWB_CONF_SCHED_SACK_BUFFER_SIZE
@@ -77,22 +105,28 @@
 
 /* SCHEDULER */
 
+/* note: all periods are given in units of 1/LWB_CONF_PERIOD_SCALE seconds */
+
 #ifndef LWB_CONF_SCHED_PERIOD_MAX
-/* max. assignable round period in seconds, must not exceed 2^15 - 1 seconds!*/
-#define LWB_CONF_SCHED_PERIOD_MAX            30      
+/* max. assignable round period, must not exceed 2^15 - 1 units! */
+#define LWB_CONF_SCHED_PERIOD_MAX            (30 * LWB_CONF_PERIOD_SCALE)
 #endif /* LWB_CONF_SCHED_PERIOD_MAX */
 
 #ifndef LWB_CONF_SCHED_PERIOD_MIN
 /* minimum round period, must be higher than T_ROUND_MAX */
-#define LWB_CONF_SCHED_PERIOD_MIN            2       
+#define LWB_CONF_SCHED_PERIOD_MIN            (2 * LWB_CONF_PERIOD_SCALE)
 #endif /* LWB_CONF_SCHED_PERIOD_MIN */ 
 
 #ifndef LWB_CONF_SCHED_PERIOD_IDLE
 /* default period (when no nodes are in the network, or the period for a 
  * static scheduler) */
-#define LWB_CONF_SCHED_PERIOD_IDLE           10      
+#define LWB_CONF_SCHED_PERIOD_IDLE           (10 * LWB_CONF_PERIOD_SCALE)
 #endif /* LWB_CONF_SCHED_PERIOD_IDLE */
 
+#if LWB_CONF_SCHED_PERIOD_MAX > 0x7fff || LWB_CONF_SCHED_PERIOD_IDLE > 0x7fff
+#error "LWB_CONF_SCHED_PERIOD_MAX is invalid (period must fit into 15 bits)"
+#endif
+
 #ifndef LWB_CONF_SCHED_STREAM_REMOVAL_THRES
 /* threshold for the stream removal (max. number of 'misses') */
 #define LWB_CONF_SCHED_STREAM_REMOVAL_THRES  10      
@@ -116,13 +150,20 @@
  * @brief the structure of a schedule packet
  */
 #define LWB_SCHED_PKT_HEADER_LEN    8
+/* slot plan: 3 bytes per entry plus 1 byte for the number of entries */
+#define LWB_SCHED_PLAN_ENTRY_LEN    3
+#define LWB_SCHED_PLAN_LEN          (LWB_CONF_SCHED_PLAN_MAX_ENTRIES * \
+                                     LWB_SCHED_PLAN_ENTRY_LEN + 1)
 typedef struct {    
-    uint32_t time;
-    uint16_t period;
+    uint32_t time;      /* in units of 1/LWB_CONF_PERIOD_SCALE seconds */
+    uint16_t period;    /* same unit as time, MSB marks the 1st schedule */
      /* store num. of data slots and last two bits to indicate whether there is
       * a contention or an s-ack slot in this round */
     uint16_t n_slots;
     uint16_t slot[LWB_CONF_MAX_DATA_SLOTS];
+#if LWB_CONF_SCHED_LOOKAHEAD
+    uint8_t  plan[LWB_SCHED_PLAN_LEN];     /* space for the slot plan */
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
 } lwb_schedule_t;
 
 /**
@@ -144,6 +185,23 @@ typedef struct {
 #endif /* LWB_CONF_STREAM_EXTRA_DATA_LEN */
 } lwb_stream_req_t;
 
+#if LWB_CONF_CHECKPOINT
+/**
+ * @brief header of the scheduler checkpoint in the external memory, followed
+ * by the first LWB_STREAM_REQ_HEADER_LEN bytes of a stream request for each
+ * stream (the extra data is not stored)
+ */
+typedef struct {
+    uint16_t crc;           /* over the header (crc = 0) and all entries */
+    uint16_t n_streams;
+    uint32_t time;          /* scheduler time of the next round */
+    uint16_t period;
+} lwb_sched_ckpt_t;
+#define LWB_SCHED_CKPT_SIZE        (sizeof(lwb_sched_ckpt_t) + \
+                                    LWB_CONF_MAX_N_STREAMS * \
+                                    LWB_STREAM_REQ_HEADER_LEN)
+#endif /* LWB_CONF_CHECKPOINT */
+
 #define LWB_SACK_MIN_PKT_LEN       4
 typedef struct {                    
     uint16_t id;              
@@ -209,6 +267,19 @@ typedef struct {
  * @brief marks schedule to have a D-ACK slot
  */
 #define LWB_SCHED_SET_DACK_SLOT(s)    ((s)->n_slots |= 0x2000)
+/**
+ * @brief marks the schedule s as a bootstrap beacon (header only), k is the
+ * number of beacon intervals until the next round starts
+ */
+#define LWB_SCHED_SET_AS_BEACON(s, k) ((s)->n_slots = 0x1000 | (k))
+/**
+ * @brief checks whether schedule is a bootstrap beacon
+ */
+#define LWB_SCHED_IS_BEACON(s)        (((s)->n_slots & 0x1000) > 0)
+/**
+ * @brief returns the number of beacon intervals until the next round
+ */
+#define LWB_SCHED_BEACON_CNT(s)       ((s)->n_slots & 0x0fff)
 
 
 /**
@@ -226,6 +297,13 @@ uint8_t lwb_sched_prepare_sack(void *payload);
  */
 void lwb_sched_proc_srq(const lwb_stream_req_t* req);
 
+/**
+ * @brief notifies the scheduler about collisions in the contention slot
+ * (mini-slots in which a signal was detected but no valid request received)
+ * @param[in] n_collisions number of collided mini-slots in this round
+ */
+void lwb_sched_notify_collision(uint8_t n_collisions);
+
 /**
  * @brief initializes the schedule
  * resets all the data structures and sets the initial values
@@ -251,6 +329,120 @@ uint16_t lwb_sched_compute(lwb_schedule_t * const sched,
 uint8_t lwb_sched_uncompress(uint8_t* compressed_data, 
                              uint8_t n_slots);
 
+#if LWB_CONF_SCHED_LOOKAHEAD
+/**
+ * @brief returns the period to use for the next round
+ * @param[in] time the current scheduler time
+ * @param[in] period the period the scheduler would like to use
+ * @return the last period as long as the published slot plan is still 
+ * valid, otherwise the requested period
+ */
+uint16_t lwb_sched_plan_hold_period(uint32_t time, uint16_t period);
+
+/**
+ * @brief start a new slot plan
+ * @param[in] time the scheduler time of the next round
+ * @param[in] period the period of the next round
+ */
+void lwb_sched_plan_init(uint32_t time, uint16_t period);
+
+/**
+ * @brief add a stream to the slot plan (streams must be sorted by node ID)
+ * @param[in] id the node ID
+ * @param[in] t_next the earliest time the stream will be assigned a slot
+ */
+void lwb_sched_plan_add(uint16_t id, uint32_t t_next);
+
+/**
+ * @brief append the slot plan to the (compressed) schedule
+ * @param[in,out] sched the schedule
+ * @param[in] slots_len the length of the (compressed) slot list in bytes
+ * @return the length of the slot plan in bytes
+ */
+uint8_t lwb_sched_plan_append(lwb_schedule_t* sched, uint8_t slots_len);
+
+/**
+ * @brief extract the hint for a node from a received schedule packet
+ * @param[in] pkt the received schedule packet
+ * @param[in] pkt_len the length of the schedule packet
+ * @param[in] id the node ID
+ * @return the number of rounds in which node id has no data slot
+ */
+uint8_t lwb_sched_plan_lookup(const uint8_t* pkt, uint8_t pkt_len, 
+                              uint16_t id);
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+
+#if LWB_CONF_STANDBY_HOST_ID
+/**
+ * @brief continue the schedule of a failed host (standby host), call this
+ * function instead of lwb_sched_init() to keep the stream table
+ * @param[out] sched the schedule
+ * @param[in] t the time of the next round
+ * @param[in] p the period of the next round
+ * @return the size of the (empty) schedule
+ */
+uint16_t lwb_sched_takeover(lwb_schedule_t* sched, uint32_t t, uint16_t p);
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+
+#if LWB_CONF_CHECKPOINT
+/**
+ * @brief save the time, the period and the stream table of the scheduler
+ * @param[in] addr address of LWB_SCHED_CKPT_SIZE bytes in the ext. memory
+ */
+void lwb_sched_save(uint32_t addr);
+
+/**
+ * @brief restore the scheduler state saved by lwb_sched_save(), call this 
+ * function after lwb_sched_init()
+ * @param[out] sched the schedule (time and period are set)
+ * @param[in] addr address of the checkpoint in the ext. memory
+ * @return 1 if successful, 0 if there is no valid checkpoint
+ */
+uint8_t lwb_sched_load(lwb_schedule_t* sched, uint32_t addr);
+
+/**
+ * @brief start writing a checkpoint (helper for the scheduler implementation)
+ * @param[in] addr address of the checkpoint in the ext. memory
+ */
+void lwb_sched_ckpt_start(uint32_t addr);
+
+/**
+ * @brief append a stream to the checkpoint
+ * @param[in] req the stream info (extra data is ignored)
+ */
+void lwb_sched_ckpt_add(const lwb_stream_req_t* req);
+
+/**
+ * @brief complete the checkpoint by writing the header
+ * @param[in] time the scheduler time of the next round
+ * @param[in] period the current round period
+ */
+void lwb_sched_ckpt_finish(uint32_t time, uint16_t period);
+
+/**
+ * @brief update the time and the period of the last checkpoint (cheap, only
+ * the header is rewritten); no effect if there is no valid checkpoint
+ * @param[in] time the scheduler time of the next round
+ * @param[in] period the current round period
+ */
+void lwb_sched_ckpt_update(uint32_t time, uint16_t period);
+
+/**
+ * @brief validate a checkpoint and read the header
+ * @param[in] addr address of the checkpoint in the ext. memory
+ * @param[out] hdr the header of the checkpoint
+ * @return 1 if the checkpoint is valid, 0 otherwise
+ */
+uint8_t lwb_sched_ckpt_open(uint32_t addr, lwb_sched_ckpt_t* hdr);
+
+/**
+ * @brief read a stream from the checkpoint opened with lwb_sched_ckpt_open()
+ * @param[in] idx index of the stream (less than hdr->n_streams)
+ * @param[out] req the stream request (extra data is set to zero)
+ */
+void lwb_sched_ckpt_get(uint16_t idx, lwb_stream_req_t* req);
+#endif /* LWB_CONF_CHECKPOINT */
+
 
 #endif /* __SCHEDULER_H__ */
 
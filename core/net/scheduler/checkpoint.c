@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2015, Swiss Federal Institute of Technology (ETH Zurich).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *  notice, this list of conditions and the following disclaimer in the
+ *  documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *  contributors may be used to endorse or promote products derived
+ *  from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:  Reto Da Forno
+ *          Federico Ferrari
+ *          Marco Zimmerling
+ */
+
+/** 
+ * @addtogroup  lwb-scheduler
+ * @{
+ *
+ * @defgroup    checkpoint Scheduler checkpoint
+ * @{
+ *
+ * @file 
+ * @brief save / restore the stream table of the scheduler in the external
+ * memory (warm restart of the host)
+ *
+ * @remarks
+ * - the header is written last, an interrupted checkpoint is therefore 
+ *   detected by the CRC
+ * - the extra data of the streams is not stored
+ */
+ 
+#include "lwb.h"
+
+#if LWB_CONF_CHECKPOINT
+/*---------------------------------------------------------------------------*/
+static uint32_t ckpt_addr = 0;
+static uint16_t ckpt_crc = 0;
+static uint16_t ckpt_n = 0;
+static uint8_t  ckpt_valid = 0;   /* the stream table in the memory is valid */
+/*---------------------------------------------------------------------------*/
+void
+lwb_sched_ckpt_start(uint32_t addr)
+{
+  ckpt_addr = addr;
+  ckpt_crc = 0;
+  ckpt_n = 0;
+  ckpt_valid = 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_sched_ckpt_add(const lwb_stream_req_t* req)
+{
+  if(ckpt_n >= LWB_CONF_MAX_N_STREAMS) {
+    return;
+  }
+  xmem_write(ckpt_addr + sizeof(lwb_sched_ckpt_t) + 
+             ckpt_n * LWB_STREAM_REQ_HEADER_LEN, 
+             LWB_STREAM_REQ_HEADER_LEN, (uint8_t*)req);
+  ckpt_crc = crc16((uint8_t*)req, LWB_STREAM_REQ_HEADER_LEN, ckpt_crc);
+  ckpt_n++;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_sched_ckpt_finish(uint32_t time, uint16_t period)
+{
+  lwb_sched_ckpt_t hdr;
+  hdr.crc       = 0;
+  hdr.n_streams = ckpt_n;
+  hdr.time      = time;
+  hdr.period    = period;
+  hdr.crc = crc16((uint8_t*)&hdr, sizeof(lwb_sched_ckpt_t), ckpt_crc);
+  if(!xmem_write(ckpt_addr, sizeof(lwb_sched_ckpt_t), (uint8_t*)&hdr)) {
+    DEBUG_PRINT_WARNING("failed to write the scheduler checkpoint");
+  }
+  ckpt_valid = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_sched_ckpt_update(uint32_t time, uint16_t period)
+{
+  if(ckpt_valid) {
+    /* same stream table, only rewrite the header */
+    lwb_sched_ckpt_finish(time, period);
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwb_sched_ckpt_open(uint32_t addr, lwb_sched_ckpt_t* hdr)
+{
+  lwb_stream_req_t req;
+  uint16_t crc, i;
+  
+  lwb_sched_ckpt_start(addr);
+  if(!xmem_read(addr, sizeof(lwb_sched_ckpt_t), (uint8_t*)hdr) ||
+     hdr->n_streams > LWB_CONF_MAX_N_STREAMS) {
+    return 0;
+  }
+  for(i = 0; i < hdr->n_streams; i++) {
+    lwb_sched_ckpt_get(i, &req);
+    ckpt_crc = crc16((uint8_t*)&req, LWB_STREAM_REQ_HEADER_LEN, ckpt_crc);
+  }
+  crc = hdr->crc;
+  hdr->crc = 0;
+  if(crc16((uint8_t*)hdr, sizeof(lwb_sched_ckpt_t), ckpt_crc) != crc) {
+    DEBUG_PRINT_WARNING("scheduler checkpoint corrupted");
+    return 0;
+  }
+  ckpt_valid = 1;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_sched_ckpt_get(uint16_t idx, lwb_stream_req_t* req)
+{
+  memset(req, 0, sizeof(lwb_stream_req_t));
+  xmem_read(ckpt_addr + sizeof(lwb_sched_ckpt_t) + 
+            idx * LWB_STREAM_REQ_HEADER_LEN,
+            LWB_STREAM_REQ_HEADER_LEN, (uint8_t*)req);
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* LWB_CONF_CHECKPOINT */
+
+/**
+ * @}
+ * @}
+ */
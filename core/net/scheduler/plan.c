@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2015, Swiss Federal Institute of Technology (ETH Zurich).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *  notice, this list of conditions and the following disclaimer in the
+ *  documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ *  contributors may be used to endorse or promote products derived
+ *  from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:  Reto Da Forno
+ *          Federico Ferrari
+ *          Marco Zimmerling
+ */
+
+/** 
+ * @addtogroup  lwb-scheduler
+ * @{
+ *
+ * @defgroup    plan Lookahead slot plan
+ * @{
+ *
+ * @file 
+ * @brief build / parse the slot plan that is appended to the schedule
+ *
+ * The slot plan tells each listed node in how many rounds its next data slot
+ * will be scheduled at the earliest. Nodes that have no slot in the next k
+ * rounds may skip these rounds entirely. To make this work, the host keeps
+ * the round period constant until the end of the published plan.
+ *
+ * @remarks
+ * - the plan is appended to the (compressed) schedule: each entry consists of
+ *   the node ID (2 bytes, little endian) and the number of rounds k (1 byte), 
+ *   the last byte of the packet holds the number of entries
+ * - the streams passed to lwb_sched_plan_add() must be sorted by node ID
+ * - nodes which have a slot in the next round are not listed
+ */
+ 
+#include "lwb.h"
+
+#if LWB_CONF_SCHED_LOOKAHEAD
+/*---------------------------------------------------------------------------*/
+static uint16_t plan_id[LWB_CONF_SCHED_PLAN_MAX_ENTRIES];
+static uint8_t  plan_k[LWB_CONF_SCHED_PLAN_MAX_ENTRIES];
+static uint8_t  plan_n = 0;
+static uint16_t plan_period = 0;
+static uint32_t plan_time = 0;
+static uint32_t plan_until = 0;    /* end of the published plan */
+/*---------------------------------------------------------------------------*/
+uint16_t
+lwb_sched_plan_hold_period(uint32_t time, uint16_t period)
+{
+  if(plan_period && (time < plan_until)) {
+    /* keep the period constant until the end of the published plan */
+    return plan_period;
+  }
+  return period;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_sched_plan_init(uint32_t time, uint16_t period)
+{
+  plan_n      = 0;
+  plan_time   = time;
+  plan_period = period;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_sched_plan_add(uint16_t id, uint32_t t_next)
+{
+  uint32_t k = 0;
+  if(t_next > plan_time && plan_period) {
+    /* number of rounds without a slot for this stream */
+    k = (t_next - plan_time + plan_period - 1) / plan_period;
+    if(k > LWB_CONF_SCHED_LOOKAHEAD) {
+      k = LWB_CONF_SCHED_LOOKAHEAD;
+    }
+  }
+  if(plan_n && plan_id[plan_n - 1] == id) {
+    /* same node: only the stream with the nearest slot counts */
+    if(k < plan_k[plan_n - 1]) {
+      plan_k[plan_n - 1] = k;
+    }
+  } else if(plan_n < LWB_CONF_SCHED_PLAN_MAX_ENTRIES) {
+    plan_id[plan_n] = id;
+    plan_k[plan_n]  = k;
+    plan_n++;
+  } /* else: no space left, this node won't be able to skip rounds */
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwb_sched_plan_append(lwb_schedule_t* sched, uint8_t slots_len)
+{
+  uint8_t  i, n = 0, k_max = 0;
+  uint8_t* out_data = (uint8_t*)sched->slot + slots_len;
+  uint16_t max_len  = sizeof(sched->slot) + LWB_SCHED_PLAN_LEN;
+  
+  if(max_len > LWB_CONF_MAX_PKT_LEN - LWB_SCHED_PKT_HEADER_LEN) {
+    max_len = LWB_CONF_MAX_PKT_LEN - LWB_SCHED_PKT_HEADER_LEN;
+  }
+  if(max_len <= slots_len) {
+    DEBUG_PRINT_ERROR("no space left for the slot plan");
+    return 0;
+  }
+  max_len -= slots_len;
+  for(i = 0; i < plan_n; i++) {
+    if(!plan_k[i]) {
+      continue;                     /* node has a slot in the next round */
+    }
+    if((n + 1) * LWB_SCHED_PLAN_ENTRY_LEN + 1 > max_len) {
+      break;
+    }
+    out_data[n * LWB_SCHED_PLAN_ENTRY_LEN]     = (uint8_t)plan_id[i];
+    out_data[n * LWB_SCHED_PLAN_ENTRY_LEN + 1] = plan_id[i] >> 8;
+    out_data[n * LWB_SCHED_PLAN_ENTRY_LEN + 2] = plan_k[i];
+    if(plan_k[i] > k_max) {
+      k_max = plan_k[i];
+    }
+    n++;
+  }
+  out_data[n * LWB_SCHED_PLAN_ENTRY_LEN] = n;   /* last byte: # entries */
+  /* the period must not change within the published plan */
+  if(plan_time + (uint32_t)k_max * plan_period > plan_until) {
+    plan_until = plan_time + (uint32_t)k_max * plan_period;
+  }
+  return n * LWB_SCHED_PLAN_ENTRY_LEN + 1;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwb_sched_plan_lookup(const uint8_t* pkt, uint8_t pkt_len, uint16_t id)
+{
+  uint8_t n;
+  
+  if(pkt_len <= LWB_SCHED_PKT_HEADER_LEN) {
+    return 0;
+  }
+  n = pkt[pkt_len - 1];
+  if((uint16_t)n * LWB_SCHED_PLAN_ENTRY_LEN + 1 > 
+     pkt_len - LWB_SCHED_PKT_HEADER_LEN) {
+    return 0;                                       /* invalid plan length */
+  }
+  pkt += pkt_len - 1 - n * LWB_SCHED_PLAN_ENTRY_LEN;
+  while(n) {
+    if(((uint16_t)pkt[1] << 8 | pkt[0]) == id) {
+      return pkt[2];
+    }
+    pkt += LWB_SCHED_PLAN_ENTRY_LEN;
+    n--;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+
+/**
+ * @}
+ * @}
+ */
@@ -241,6 +241,12 @@ lwb_sched_stream_in_list(uint16_t id,
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+lwb_sched_notify_collision(uint8_t n_collisions)
+{
+  /* nothing to do, there is a contention slot in every round */
+}
+/*---------------------------------------------------------------------------*/
 uint16_t 
 lwb_sched_compute(lwb_schedule_t * const sched, 
                   const uint8_t * const streams_to_update, 
@@ -288,6 +294,10 @@ lwb_sched_compute(lwb_schedule_t * const sched,
   
   /* set the period to the smallest IPI among all active streams */
   period = min_ipi; 
+#if LWB_CONF_SCHED_LOOKAHEAD
+  /* a new period must not take effect before the end of the slot plan */
+  period = lwb_sched_plan_hold_period(time, period);
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
   time += period;   /* increment time by the current period */
 
   if(n_streams == 0) {
@@ -340,11 +350,20 @@ lwb_sched_compute(lwb_schedule_t * const sched,
   memcpy(&sched->slot[n_slots_assigned - first_index + reserve_slot_host], 
          slots_tmp, first_index * sizeof(sched->slot[0]));
   
-set_schedule:
+set_schedule: ;
+#if LWB_CONF_DATA_ACK
+  uint16_t last_n_slots = LWB_SCHED_N_SLOTS(sched);
+#endif /* LWB_CONF_DATA_ACK */
   sched->n_slots = n_slots_assigned;
   if(n_pending_sack) {
     LWB_SCHED_SET_SACK_SLOT(sched);
   }  
+#if LWB_CONF_DATA_ACK
+  /* acknowledge the data packets of the last round */
+  if(last_n_slots) {
+    LWB_SCHED_SET_DACK_SLOT(sched);
+  }
+#endif /* LWB_CONF_DATA_ACK */
   /* always schedule a contention slot! */
   LWB_SCHED_SET_CONT_SLOT(sched);
   
@@ -359,6 +378,17 @@ set_schedule:
   compressed_size = n_slots_assigned * 2;
 #endif /* LWB_CONF_SCHED_COMPRESS */
 
+#if LWB_CONF_SCHED_LOOKAHEAD
+  /* append the earliest next slot of each node to the schedule */
+  lwb_sched_plan_init(time, period);
+  for(curr_stream = list_head(streams_list); curr_stream != NULL; 
+      curr_stream = curr_stream->next) {
+    lwb_sched_plan_add(curr_stream->id, (curr_stream->n_cons_missed & 0x80) ?
+                       time : (curr_stream->last_assigned + curr_stream->ipi));
+  }
+  compressed_size += lwb_sched_plan_append(sched, compressed_size);
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+
   /* this schedule is sent at the end of a round: do not communicate 
    * (i.e. do not set the first bit of period) */
   sched->period = period;   /* no need to clear the last bit */
@@ -398,6 +428,76 @@ lwb_sched_init(lwb_schedule_t* sched)
   return LWB_SCHED_PKT_HEADER_LEN; /* empty schedule, no slots allocated yet */
 }
 /*---------------------------------------------------------------------------*/
+#if LWB_CONF_STANDBY_HOST_ID
+uint16_t
+lwb_sched_takeover(lwb_schedule_t* sched, uint32_t t, uint16_t p)
+{
+  lwb_stream_list_t *s;
+  
+  time = t;
+  period = p;
+  /* the mirrored streams are due from now on */
+  for(s = list_head(streams_list); s != 0; s = s->next) {
+    s->last_assigned = time;
+    s->n_cons_missed = 0;
+  }
+  n_pending_sack = 0;
+  sched->n_slots = 0;                                       /* no data slots */
+  LWB_SCHED_SET_CONT_SLOT(sched);               /* include a contention slot */
+  sched->time = time;
+  sched->period = period;
+  LWB_SCHED_SET_AS_1ST(sched);
+  DEBUG_PRINT_INFO("scheduler taken over (%u streams)", n_streams);
+  
+  return LWB_SCHED_PKT_HEADER_LEN;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+#if LWB_CONF_CHECKPOINT
+void
+lwb_sched_save(uint32_t addr)
+{
+  lwb_stream_list_t *s;
+  lwb_stream_req_t req;
+  
+  memset(&req, 0, sizeof(lwb_stream_req_t));
+  lwb_sched_ckpt_start(addr);
+  for(s = list_head(streams_list); s != 0; s = s->next) {
+    req.id        = s->id;
+    req.stream_id = s->stream_id;
+    req.ipi       = s->ipi;
+    lwb_sched_ckpt_add(&req);
+  }
+  lwb_sched_ckpt_finish(time, period);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwb_sched_load(lwb_schedule_t* sched, uint32_t addr)
+{
+  lwb_sched_ckpt_t hdr;
+  lwb_stream_req_t req;
+  uint16_t i;
+  
+  if(!lwb_sched_ckpt_open(addr, &hdr)) {
+    return 0;
+  }
+  /* the time spent in the reset is unknown, continue with the next round */
+  period = hdr.period;
+  time = hdr.time + period;
+  for(i = 0; i < hdr.n_streams; i++) {
+    lwb_sched_ckpt_get(i, &req);
+    lwb_sched_proc_srq(&req);
+    n_pending_sack = 0;              /* the sources are not notified */
+  }
+  sched->time = time;
+  sched->period = period;
+  LWB_SCHED_SET_AS_1ST(sched);
+  DEBUG_PRINT_INFO("scheduler restored (%u streams)", n_streams);
+  
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LWB_CONF_CHECKPOINT */
 
 #endif /* LWB_SCHED_MIN_DELAY */
 
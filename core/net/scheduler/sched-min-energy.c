@@ -49,13 +49,18 @@
  * to reduce chances of a link loss and thus increase stability.
  * 
  * @remarks:
- * - TIME_SCALE removed (i.e. fixed to 1)
+ * - periods and IPIs in units of 1/LWB_CONF_PERIOD_SCALE seconds
  * - dynamic period only
  * - JOINING_NODES, TWO_SCHEDS, COMPRESS, REMOVE_NODES and DYNAMIC_FREE_SLOTS 
  *   set to 1 (i.e. removed)
  * - everything with MINIMIZE_LATENCY removed
  * - external memory support added
  * - list for pending S-ACKs added
+ * - contention slots are only scheduled if needed: the interval between two
+ *   contention slots doubles with each idle contention slot (up to 
+ *   LWB_CONF_SCHED_T_CONT_MAX) and is reset as soon as a stream request 
+ *   arrives; after a reboot or when streams are lost, there is a contention
+ *   slot in each of the next LWB_CONF_SCHED_CONT_BURST rounds
  */
  
 #include "lwb.h"
@@ -109,6 +114,9 @@ static uint8_t           n_slots_assigned;   /* # assigned slots */
 static uint8_t           saturated = 0;
 static uint32_t          data_cnt;
 static uint16_t          data_ipi;
+static uint32_t          cont_interval;      /* time between cont. slots */
+static uint8_t           cont_burst;         /* # rounds in burst mode */
+static uint8_t           n_srq_rcvd;         /* # requests since last round */
 static volatile uint8_t  n_pending_sack = 0;
 /* factor of 4 because of the memory alignment and faster index calculation! */
 static uint8_t           pending_sack[4 * LWB_CONF_SCHED_SACK_BUFFER_SIZE]; 
@@ -217,6 +225,7 @@ lwb_sched_proc_srq(const lwb_stream_req_t* req)
   lwb_stream_extra_data_t* extra_data = 
     (lwb_stream_extra_data_t*)req->extra_data;
   sched_stats.t_last_req = time;
+  n_srq_rcvd++;
      
   if(LWB_INVALID_STREAM_ID == req->stream_id) { 
     DEBUG_PRINT_WARNING("invalid stream request (LWB_INVALID_STREAM_ID)");
@@ -476,12 +485,23 @@ lwb_sched_stream_in_list(uint16_t id,
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+void
+lwb_sched_notify_collision(uint8_t n_collisions)
+{
+  /* colliding requests indicate pending demand: treat them like received 
+   * requests to keep the contention slots coming */
+  n_srq_rcvd += n_collisions;
+  sched_stats.t_last_req = time;
+}
+/*---------------------------------------------------------------------------*/
 uint16_t 
 lwb_sched_compute(lwb_schedule_t * const sched, 
                   const uint8_t * const streams_to_update, 
                   uint8_t reserve_slot_host) 
 {  
   static uint16_t slots_tmp[LWB_CONF_MAX_DATA_SLOTS];
+  uint8_t  had_cont_slot = LWB_SCHED_HAS_CONT_SLOT(sched);
+  uint16_t n_deleted = sched_stats.n_deleted;
 
   data_ipi = 1;
   data_cnt = 0;
@@ -555,6 +575,10 @@ lwb_sched_compute(lwb_schedule_t * const sched,
     stream_addr = curr_stream.next;      
   }
 #endif /* LWB_CONF_SCHED_USE_XMEM */
+  if(n_deleted != sched_stats.n_deleted) {
+    /* streams lost: the topology may have changed, let the nodes rejoin */
+    cont_burst = LWB_CONF_SCHED_CONT_BURST;
+  }
 
   /* clear content of the schedule (do NOT move this line further above!) */
   memset(sched->slot, 0, sizeof(sched->slot));  
@@ -566,6 +590,10 @@ lwb_sched_compute(lwb_schedule_t * const sched,
     sched_stats.t_last_req = time;
   }  
   period = lwb_sched_adapt_period();               /* adapt the round period */
+#if LWB_CONF_SCHED_LOOKAHEAD
+  /* a new period must not take effect before the end of the slot plan */
+  period = lwb_sched_plan_hold_period(time, period);
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
   time += period;                    /* increment time by the current period */
 
   if(n_streams == 0) {  
@@ -702,19 +730,41 @@ lwb_sched_compute(lwb_schedule_t * const sched,
   memcpy(&sched->slot[n_slots_assigned - first_index + reserve_slot_host], 
          slots_tmp, first_index * sizeof(sched->slot[0]));
   
-set_schedule:
+set_schedule: ;
+#if LWB_CONF_DATA_ACK
+  uint16_t last_n_slots = LWB_SCHED_N_SLOTS(sched);
+#endif /* LWB_CONF_DATA_ACK */
   sched->n_slots = n_slots_assigned;
 
   if(n_pending_sack) {
     LWB_SCHED_SET_SACK_SLOT(sched);
   }
-  //if((time < (sched_stats.t_last_req + LWB_CONF_SCHED_T_NO_REQ)) || 
-  //   (time >= (sched_stats.t_last_cont + LWB_CONF_SCHED_T_NO_REQ)) ||
-  //   !data_cnt) {    -> always schedule a contention slot
-    /* schedule a contention slot */
+#if LWB_CONF_DATA_ACK
+  /* acknowledge the data packets of the last round */
+  if(last_n_slots) {
+    LWB_SCHED_SET_DACK_SLOT(sched);
+  }
+#endif /* LWB_CONF_DATA_ACK */
+  /* adapt the interval between two contention slots to the request rate */
+  if(n_srq_rcvd) {
+    cont_interval = 0;          /* demand: contention slot in each round */
+  } else if(had_cont_slot && cont_interval < LWB_CONF_SCHED_T_CONT_MAX) {
+    /* contention slot was not used: halve the frequency */
+    cont_interval = cont_interval ? (cont_interval * 2) : period;
+    if(cont_interval > LWB_CONF_SCHED_T_CONT_MAX) {
+      cont_interval = LWB_CONF_SCHED_T_CONT_MAX;
+    }
+  }
+  n_srq_rcvd = 0;
+  /* schedule a contention slot if the next opportunity would be too late */
+  if(cont_burst || 
+     ((time - sched_stats.t_last_cont + period) > cont_interval)) {
+    if(cont_burst) {
+      cont_burst--;
+    }
     sched_stats.t_last_cont = time;
     LWB_SCHED_SET_CONT_SLOT(sched);
-  //}  
+  }
   
 #if LWB_CONF_SCHED_COMPRESS
   uint8_t len = lwb_sched_compress((uint8_t*)sched->slot, n_slots_assigned);
@@ -725,6 +775,27 @@ set_schedule:
   uint8_t len = n_slots_assigned * 2;
 #endif /* LWB_CONF_SCHED_COMPRESS */
 
+#if LWB_CONF_SCHED_LOOKAHEAD
+  /* append the earliest next slot of each node to the schedule */
+  lwb_sched_plan_init(time, period);
+ #if !LWB_CONF_SCHED_USE_XMEM
+  for(curr_stream = list_head(streams_list); curr_stream != NULL; 
+      curr_stream = curr_stream->next) {
+    lwb_sched_plan_add(curr_stream->id, (curr_stream->n_cons_missed & 0x80) ?
+                       time : (curr_stream->last_assigned + curr_stream->ipi));
+  }
+ #else /* LWB_CONF_SCHED_USE_XMEM */
+  stream_addr = streams_list;
+  while(stream_addr != MEMBX_INVALID_ADDR) {
+    xmem_read(stream_addr, sizeof(lwb_stream_list_t), (uint8_t*)&curr_stream);
+    lwb_sched_plan_add(curr_stream.id, (curr_stream.n_cons_missed & 0x80) ?
+                       time : (curr_stream.last_assigned + curr_stream.ipi));
+    stream_addr = curr_stream.next;
+  }
+ #endif /* LWB_CONF_SCHED_USE_XMEM */
+  len += lwb_sched_plan_append(sched, len);
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+
   /* this schedule is sent at the end of a round: do not communicate 
    * (i.e. do not set the first bit of period) */
   sched->period = period;   /* no need to clear the last bit */
@@ -753,6 +824,9 @@ lwb_sched_init(lwb_schedule_t* sched)
   n_streams = 0;
   n_slots_assigned = 0;
   n_pending_sack = 0;
+  n_srq_rcvd = 0;
+  cont_interval = 0;
+  cont_burst = LWB_CONF_SCHED_CONT_BURST;  /* let the nodes (re)join quickly */
   time = 0;                                        /* global time starts now */
   period = LWB_CONF_SCHED_PERIOD_IDLE;
   sched->n_slots = 0;                                       /* no data slots */
@@ -769,6 +843,113 @@ lwb_sched_init(lwb_schedule_t* sched)
   return LWB_SCHED_PKT_HEADER_LEN; /* empty schedule, no slots allocated yet */
 }
 /*---------------------------------------------------------------------------*/
+#if LWB_CONF_STANDBY_HOST_ID
+uint16_t
+lwb_sched_takeover(lwb_schedule_t* sched, uint32_t t, uint16_t p)
+{
+#if !LWB_CONF_SCHED_USE_XMEM
+  lwb_stream_list_t *s;
+#else /* LWB_CONF_SCHED_USE_XMEM */
+  lwb_stream_list_t s;
+  uint32_t stream_addr = streams_list;
+#endif /* LWB_CONF_SCHED_USE_XMEM */
+  
+  time = t;
+  period = p;
+  /* the mirrored streams are due from now on */
+#if !LWB_CONF_SCHED_USE_XMEM
+  for(s = list_head(streams_list); s != 0; s = s->next) {
+    s->last_assigned = time;
+    s->n_cons_missed = 0;
+  }
+#else /* LWB_CONF_SCHED_USE_XMEM */
+  while(stream_addr != MEMBX_INVALID_ADDR) {
+    xmem_read(stream_addr, sizeof(lwb_stream_list_t), (uint8_t*)&s);
+    s.last_assigned = time;
+    s.n_cons_missed = 0;
+    xmem_write(stream_addr, sizeof(lwb_stream_list_t), (uint8_t*)&s);
+    stream_addr = s.next;
+  }
+#endif /* LWB_CONF_SCHED_USE_XMEM */
+  n_srq_rcvd = 0;
+  cont_burst = LWB_CONF_SCHED_CONT_BURST;  /* let the nodes (re)join quickly */
+  sched_stats.t_last_cont = time;
+  sched_stats.t_last_req = time;
+  n_pending_sack = 0;
+  sched->n_slots = 0;                                       /* no data slots */
+  LWB_SCHED_SET_CONT_SLOT(sched);               /* include a contention slot */
+  sched->time = time;
+  sched->period = period;
+  LWB_SCHED_SET_AS_1ST(sched);
+  DEBUG_PRINT_INFO("scheduler taken over (%u streams)", n_streams);
+  
+  return LWB_SCHED_PKT_HEADER_LEN;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+#if LWB_CONF_CHECKPOINT
+void
+lwb_sched_save(uint32_t addr)
+{
+#if !LWB_CONF_SCHED_USE_XMEM
+  lwb_stream_list_t *s;
+#else /* LWB_CONF_SCHED_USE_XMEM */
+  lwb_stream_list_t s;
+  uint32_t stream_addr = streams_list;
+#endif /* LWB_CONF_SCHED_USE_XMEM */
+  lwb_stream_req_t req;
+  
+  memset(&req, 0, sizeof(lwb_stream_req_t));
+  lwb_sched_ckpt_start(addr);
+#if !LWB_CONF_SCHED_USE_XMEM
+  for(s = list_head(streams_list); s != 0; s = s->next) {
+    req.id        = s->id;
+    req.stream_id = s->stream_id;
+    req.ipi       = s->ipi;
+    lwb_sched_ckpt_add(&req);
+  }
+#else /* LWB_CONF_SCHED_USE_XMEM */
+  while(stream_addr != MEMBX_INVALID_ADDR) {
+    xmem_read(stream_addr, sizeof(lwb_stream_list_t), (uint8_t*)&s);
+    req.id        = s.id;
+    req.stream_id = s.stream_id;
+    req.ipi       = s.ipi;
+    lwb_sched_ckpt_add(&req);
+    stream_addr = s.next;
+  }
+#endif /* LWB_CONF_SCHED_USE_XMEM */
+  lwb_sched_ckpt_finish(time, period);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwb_sched_load(lwb_schedule_t* sched, uint32_t addr)
+{
+  lwb_sched_ckpt_t hdr;
+  lwb_stream_req_t req;
+  uint16_t i;
+  
+  if(!lwb_sched_ckpt_open(addr, &hdr)) {
+    return 0;
+  }
+  /* the time spent in the reset is unknown, continue with the next round */
+  period = hdr.period;
+  time = hdr.time + period;
+  for(i = 0; i < hdr.n_streams; i++) {
+    lwb_sched_ckpt_get(i, &req);
+    lwb_sched_proc_srq(&req);
+    n_pending_sack = 0;              /* the sources are not notified */
+  }
+  n_srq_rcvd = 0;
+  sched_stats.t_last_req = time;
+  sched->time = time;
+  sched->period = period;
+  LWB_SCHED_SET_AS_1ST(sched);
+  DEBUG_PRINT_INFO("scheduler restored (%u streams)", n_streams);
+  
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LWB_CONF_CHECKPOINT */
 
 #endif /* LWB_SCHED_MIN_ENERGY */
 
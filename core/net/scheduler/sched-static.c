@@ -246,12 +246,19 @@ lwb_sched_set_period(uint16_t p)
   if (p) { period = p; }
 }
 /*---------------------------------------------------------------------------*/
+void
+lwb_sched_notify_collision(uint8_t n_collisions)
+{
+  /* nothing to do, there is a contention slot in every round */
+}
+/*---------------------------------------------------------------------------*/
 uint16_t 
 lwb_sched_compute(lwb_schedule_t * const sched, 
                   const uint8_t * const streams_to_update, 
                   uint8_t reserve_slot_host) 
 {
   static uint16_t slots_tmp[LWB_CONF_MAX_DATA_SLOTS];
+  uint16_t round_period = period;
     
   first_index = 0; 
   n_slots_assigned = 0;
@@ -291,8 +298,11 @@ lwb_sched_compute(lwb_schedule_t * const sched,
   }
   
   /* keep the round period constant */
-
-  time += period;   /* increment time by the current period */
+#if LWB_CONF_SCHED_LOOKAHEAD
+  /* a new period must not take effect before the end of the slot plan */
+  round_period = lwb_sched_plan_hold_period(time, period);
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+  time += round_period;   /* increment time by the current period */
 
   if(n_streams == 0) {
     /* no streams to process */
@@ -379,7 +389,18 @@ set_schedule: ;
   compressed_size = n_slots_assigned * 2;
 #endif /* LWB_CONF_SCHED_COMPRESS */
 
-  sched->period = period;   /* no need to clear the last bit */
+#if LWB_CONF_SCHED_LOOKAHEAD
+  /* append the earliest next slot of each node to the schedule */
+  lwb_sched_plan_init(time, round_period);
+  for(curr_stream = list_head(streams_list); curr_stream != NULL; 
+      curr_stream = curr_stream->next) {
+    lwb_sched_plan_add(curr_stream->id, (curr_stream->n_cons_missed & 0x80) ?
+                       time : (curr_stream->last_assigned + curr_stream->ipi));
+  }
+  compressed_size += lwb_sched_plan_append(sched, compressed_size);
+#endif /* LWB_CONF_SCHED_LOOKAHEAD */
+
+  sched->period = round_period;   /* no need to clear the last bit */
   sched->time   = time;
     
   /* log the parameters of the new schedule */
@@ -415,6 +436,76 @@ lwb_sched_init(lwb_schedule_t* sched)
   return LWB_SCHED_PKT_HEADER_LEN; /* empty schedule, no slots allocated yet */
 }
 /*---------------------------------------------------------------------------*/
+#if LWB_CONF_STANDBY_HOST_ID
+uint16_t
+lwb_sched_takeover(lwb_schedule_t* sched, uint32_t t, uint16_t p)
+{
+  lwb_stream_list_t *s;
+  
+  time = t;
+  period = p;
+  /* the mirrored streams are due from now on */
+  for(s = list_head(streams_list); s != 0; s = s->next) {
+    s->last_assigned = time;
+    s->n_cons_missed = 0;
+  }
+  n_pending_sack = 0;
+  sched->n_slots = 0;                                       /* no data slots */
+  LWB_SCHED_SET_CONT_SLOT(sched);               /* include a contention slot */
+  sched->time = time;
+  sched->period = period;
+  LWB_SCHED_SET_AS_1ST(sched);
+  DEBUG_PRINT_INFO("scheduler taken over (%u streams)", n_streams);
+  
+  return LWB_SCHED_PKT_HEADER_LEN;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LWB_CONF_STANDBY_HOST_ID */
+#if LWB_CONF_CHECKPOINT
+void
+lwb_sched_save(uint32_t addr)
+{
+  lwb_stream_list_t *s;
+  lwb_stream_req_t req;
+  
+  memset(&req, 0, sizeof(lwb_stream_req_t));
+  lwb_sched_ckpt_start(addr);
+  for(s = list_head(streams_list); s != 0; s = s->next) {
+    req.id        = s->id;
+    req.stream_id = s->stream_id;
+    req.ipi       = s->ipi;
+    lwb_sched_ckpt_add(&req);
+  }
+  lwb_sched_ckpt_finish(time, period);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+lwb_sched_load(lwb_schedule_t* sched, uint32_t addr)
+{
+  lwb_sched_ckpt_t hdr;
+  lwb_stream_req_t req;
+  uint16_t i;
+  
+  if(!lwb_sched_ckpt_open(addr, &hdr)) {
+    return 0;
+  }
+  /* the time spent in the reset is unknown, continue with the next round */
+  period = hdr.period;
+  time = hdr.time + period;
+  for(i = 0; i < hdr.n_streams; i++) {
+    lwb_sched_ckpt_get(i, &req);
+    lwb_sched_proc_srq(&req);
+    n_pending_sack = 0;              /* the sources are not notified */
+  }
+  sched->time = time;
+  sched->period = period;
+  LWB_SCHED_SET_AS_1ST(sched);
+  DEBUG_PRINT_INFO("scheduler restored (%u streams)", n_streams);
+  
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* LWB_CONF_CHECKPOINT */
 
 #endif /* LWB_SCHED_STATIC */
 
@@ -37,6 +37,10 @@
 
 /*---------------------------------------------------------------------------*/
 static lwb_stream_t streams[LWB_CONF_MAX_N_STREAMS_PER_NODE];
+/* binary exponential backoff: number of unacknowledged requests and the
+ * number of contention slots to wait until the next request */
+static uint8_t      n_attempts[LWB_CONF_MAX_N_STREAMS_PER_NODE];
+static uint8_t      backoff[LWB_CONF_MAX_N_STREAMS_PER_NODE];
 volatile uint32_t lwb_pending_requests = 0;      
 volatile uint8_t  lwb_joined_streams_cnt = 0;    /* number of active streams */
 /*---------------------------------------------------------------------------*/
@@ -46,6 +50,8 @@ lwb_stream_init()
   memset(streams, 0, 
          (LWB_STREAM_INFO_HEADER_LEN + LWB_CONF_STREAM_EXTRA_DATA_LEN) * 
          LWB_CONF_MAX_N_STREAMS_PER_NODE);
+  memset(n_attempts, 0, sizeof(n_attempts));
+  memset(backoff, 0, sizeof(backoff));
   lwb_pending_requests = 0;
   lwb_joined_streams_cnt = 0;
 }
@@ -58,6 +64,8 @@ lwb_stream_update_state(uint8_t stream_id)
     if(streams[i].id == stream_id) {
       /* clear the corresponding bit */
       lwb_pending_requests &= ~((uint32_t)1 << i);  
+      n_attempts[i] = 0;
+      backoff[i] = 0;
       if(streams[i].ipi) {
         if(streams[i].state != LWB_STREAM_STATE_ACTIVE) {
           streams[i].state = LWB_STREAM_STATE_ACTIVE;
@@ -95,6 +103,7 @@ lwb_stream_add(const lwb_stream_req_t* const stream_info)
              LWB_STREAM_REQ_HEADER_LEN - 4 + LWB_CONF_STREAM_EXTRA_DATA_LEN);
       streams[i].state = LWB_STREAM_STATE_WAITING;                 /* rejoin */    
       lwb_pending_requests |= (1 << i);     /* set the 'request pending' bit */
+      n_attempts[i] = 0;
       DEBUG_PRINT_INFO("stream with ID %u updated (IPI %u)", 
                        stream_info->stream_id, 
                        stream_info->ipi);
@@ -111,6 +120,8 @@ lwb_stream_add(const lwb_stream_req_t* const stream_info)
            (LWB_STREAM_REQ_HEADER_LEN + LWB_CONF_STREAM_EXTRA_DATA_LEN - 2));
     streams[idx].state = LWB_STREAM_STATE_WAITING;
     lwb_pending_requests |= (1 << idx);     /* set the 'request pending' bit */
+    n_attempts[idx] = 0;
+    backoff[idx] = 0;
     DEBUG_PRINT_INFO("stream with ID %u added (IPI %u)", 
                      streams[idx].id, streams[idx].ipi);
     return 1;
@@ -148,6 +159,8 @@ lwb_stream_rejoin(void)
     if(streams[i].state == LWB_STREAM_STATE_ACTIVE) {
       streams[i].state = LWB_STREAM_STATE_WAITING;
       lwb_pending_requests |= (1 << i);
+      n_attempts[i] = 0;
+      backoff[i] = 0;
     }
   }
 }
@@ -155,29 +168,86 @@ lwb_stream_rejoin(void)
 uint8_t
 lwb_stream_prepare_req(lwb_stream_req_t* const out_srq_pkt, uint8_t stream_id) 
 {
-  if(stream_id == LWB_INVALID_STREAM_ID || 
-    streams[stream_id].state != LWB_STREAM_STATE_WAITING) {
-    /* get the first stream request in the list */
-    uint8_t i = 0;
-    stream_id = LWB_INVALID_STREAM_ID;
+  uint8_t i = 0, idx = 0xff;
+  if(stream_id != LWB_INVALID_STREAM_ID) {
+    /* search the stream */
     for(; i < LWB_CONF_MAX_N_STREAMS_PER_NODE; i++) {
-      if(streams[i].state == LWB_STREAM_STATE_WAITING) {
-        stream_id = i;
+      if(streams[i].id == stream_id && 
+         streams[i].state == LWB_STREAM_STATE_WAITING) {
+        idx = i;
         break;
       }
     }
   }
-  if(LWB_INVALID_STREAM_ID != stream_id) {
+  if(idx == 0xff) {
+    /* get the first stream request in the list that is not backing off */
+    for(i = 0; i < LWB_CONF_MAX_N_STREAMS_PER_NODE; i++) {
+      if(streams[i].state == LWB_STREAM_STATE_WAITING && !backoff[i]) {
+        idx = i;
+        break;
+      }
+    }
+  }
+  if(idx != 0xff) {
     /* compose the packet */
     out_srq_pkt->id = node_id;
     memcpy((uint8_t*)out_srq_pkt + 3,  /* skip the first 3 bytes */
-           (uint8_t*)&streams[stream_id] + 1, 
+           (uint8_t*)&streams[idx] + 1, 
            LWB_STREAM_REQ_HEADER_LEN - 3 + LWB_CONF_STREAM_EXTRA_DATA_LEN);
     return 1;
   }
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+uint8_t
+lwb_stream_get_pending(void)
+{
+  uint8_t i = 0;
+  for(; i < LWB_CONF_MAX_N_STREAMS_PER_NODE; i++) {
+    if(streams[i].state == LWB_STREAM_STATE_WAITING) {
+      return streams[i].id;
+    }
+  }
+  return LWB_INVALID_STREAM_ID;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_stream_req_sent(uint8_t stream_id)
+{
+  uint8_t i = 0;
+  for(; i < LWB_CONF_MAX_N_STREAMS_PER_NODE; i++) {
+    if(streams[i].id == stream_id) {
+#if LWB_CONF_MAX_CONT_BACKOFF
+      /* double the backoff window with each unacknowledged request */
+      uint16_t window = (uint16_t)1 << n_attempts[i];
+      if(window < LWB_CONF_MAX_CONT_BACKOFF) {
+        n_attempts[i]++;
+        window <<= 1;
+      }
+      if(window > LWB_CONF_MAX_CONT_BACKOFF) {
+        window = LWB_CONF_MAX_CONT_BACKOFF;
+      }
+      /* skip between 1 and 'window' contention slots (+1 since the counter 
+       * is decremented at the start of each contention slot, before the 
+       * request is prepared) */
+      backoff[i] = (random_rand() >> 1) % window + 2;
+#endif /* LWB_CONF_MAX_CONT_BACKOFF */
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_stream_backoff(void)
+{
+  uint8_t i = 0;
+  for(; i < LWB_CONF_MAX_N_STREAMS_PER_NODE; i++) {
+    if(backoff[i]) {
+      backoff[i]--;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 lwb_stream_state_t lwb_stream_get_state(uint8_t stream_id)
 {
   uint8_t i = 0;
@@ -189,4 +259,40 @@ lwb_stream_state_t lwb_stream_get_state(uint8_t stream_id)
   }
   return LWB_STREAM_STATE_INACTIVE;    
 }
-/*---------------------------------------------------------------------------*/
\ No newline at end of file
+/*---------------------------------------------------------------------------*/
+uint16_t
+lwb_stream_get_ipi(uint8_t stream_id)
+{
+  uint8_t i = 0;
+  for(; i < LWB_CONF_MAX_N_STREAMS_PER_NODE; i++) {
+    if(streams[i].id == stream_id &&
+       streams[i].state != LWB_STREAM_STATE_INACTIVE) {
+      return streams[i].ipi;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_stream_export(uint8_t* buf)
+{
+  memcpy(buf, streams, LWB_STREAM_TABLE_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+void
+lwb_stream_import(const uint8_t* buf)
+{
+  uint8_t i = 0;
+  lwb_stream_init();
+  memcpy(streams, buf, LWB_STREAM_TABLE_SIZE);
+  for(; i < LWB_CONF_MAX_N_STREAMS_PER_NODE; i++) {
+    if(streams[i].state == LWB_STREAM_STATE_WAITING) {
+      lwb_pending_requests |= ((uint32_t)1 << i);
+    } else if(streams[i].state == LWB_STREAM_STATE_ACTIVE) {
+      lwb_joined_streams_cnt++;
+    } else {
+      streams[i].state = LWB_STREAM_STATE_INACTIVE;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
@@ -88,6 +88,9 @@ typedef struct {
   uint8_t             extra_data[LWB_CONF_STREAM_EXTRA_DATA_LEN];
 #endif /* LWB_CONF_STREAM_EXTRA_DATA_LEN */
 } lwb_stream_t;
+/* size of the stream table in bytes (see lwb_stream_export()) */
+#define LWB_STREAM_TABLE_SIZE           (sizeof(lwb_stream_t) * \
+                                         LWB_CONF_MAX_N_STREAMS_PER_NODE)
 
 
 extern volatile uint32_t lwb_pending_requests;
@@ -133,12 +136,35 @@ void lwb_stream_rejoin(void);
  * @param[out] out_srq_pkt the output buffer for the generated stream request
  * packet
  * @param stream_id optional parameter, set this to LWB_INVALID_STREAM_ID if 
- * the function shall deside which stream request to send
+ * the function shall deside which stream request to send (streams that are 
+ * backing off are skipped in this case)
  * @return 1 if successful, 0 otherwise
  */
 uint8_t 
 lwb_stream_prepare_req(lwb_stream_req_t* const out_srq_pkt, uint8_t stream_id);
 
+/**
+ * @brief get the ID of the first stream with a pending request (ignores the
+ * backoff, to be used for requests that are sent in a data slot)
+ * @return the stream ID or LWB_INVALID_STREAM_ID if there is none
+ */
+uint8_t lwb_stream_get_pending(void);
+
+/**
+ * @brief notify the stream module that a request for this stream has been 
+ * sent in the contention slot (binary exponential backoff: the stream waits
+ * for 1 to 2^n contention slots before the next attempt, where n is the 
+ * number of unacknowledged requests, max. LWB_CONF_MAX_CONT_BACKOFF slots)
+ * @param stream_id ID of the stream
+ */
+void lwb_stream_req_sent(uint8_t stream_id);
+
+/**
+ * @brief decrease the backoff counters, call this function once per 
+ * contention slot
+ */
+void lwb_stream_backoff(void);
+
 
 /**
  * @brief get the state of the stream
@@ -148,6 +174,25 @@ lwb_stream_prepare_req(lwb_stream_req_t* const out_srq_pkt, uint8_t stream_id);
  */
 lwb_stream_state_t lwb_stream_get_state(uint8_t stream_id);
 
+/**
+ * @brief get the inter-packet interval of a stream
+ * @return the IPI or 0 if the stream does not exist or is inactive
+ */
+uint16_t lwb_stream_get_ipi(uint8_t stream_id);
+
+/**
+ * @brief copy the stream table into a buffer (e.g. to save a checkpoint)
+ * @param[out] buf output buffer of LWB_STREAM_TABLE_SIZE bytes
+ */
+void lwb_stream_export(uint8_t* buf);
+
+/**
+ * @brief restore the stream table from a buffer filled by lwb_stream_export()
+ * @param[in] buf the saved stream table
+ * @note the backoff is reset, pending requests are resent
+ */
+void lwb_stream_import(const uint8_t* buf);
+
 
 #endif /* __STREAM_H__ */
 
@@ -231,6 +231,14 @@ typedef struct {
           relay_cnt_t_ref;
   uint8_t relay_cnt_timeout;
   uint8_t t_ref_updated;
+#if GLOSSY_CONF_T_REF_AVG
+  /* sum of the offsets of the timestamps and of the relay counters w.r.t. 
+   * the first timestamp (t_ref) */
+  int32_t t_ref_ofs_sum;
+  int16_t relay_cnt_ofs_sum;
+  uint8_t n_t_ref;
+  uint8_t t_ref_frac;
+#endif /* GLOSSY_CONF_T_REF_AVG */
   uint8_t header_ok;
 #ifdef GLOSSY_DISABLE_INTERRUPTS
   uint32_t enabled_interrupts;
@@ -361,8 +369,31 @@ update_t_ref(rtimer_clock_t t_ref, uint8_t relay_cnt)
   g.t_ref = t_ref;
   g.t_ref_updated = 1;
   g.relay_cnt_t_ref = relay_cnt;
+#if GLOSSY_CONF_T_REF_AVG
+  g.t_ref_ofs_sum = 0;
+  g.relay_cnt_ofs_sum = 0;
+  g.n_t_ref = 1;
+#endif /* GLOSSY_CONF_T_REF_AVG */
 }
 /*---------------------------------------------------------------------------*/
+#if GLOSSY_CONF_T_REF_AVG
+static inline void
+add_t_ref_measurement(rtimer_clock_t t, uint8_t relay_cnt)
+{
+  int32_t ofs = (int32_t)(t - g.t_ref);
+  int32_t dev = ofs - (int32_t)(relay_cnt - g.relay_cnt_t_ref) * 
+                      (int32_t)g.T_slot_estimated;
+  /* the tolerance grows with the number of slots in between */
+  int32_t tol = (int32_t)(relay_cnt - g.relay_cnt_t_ref + 1) * 
+                T_SLOT_TOLERANCE;
+  if((relay_cnt > g.relay_cnt_t_ref) && (dev < tol) && (dev > -tol)) {
+    g.t_ref_ofs_sum += ofs;
+    g.relay_cnt_ofs_sum += relay_cnt - g.relay_cnt_t_ref;
+    g.n_t_ref++;
+  }
+}
+#endif /* GLOSSY_CONF_T_REF_AVG */
+/*---------------------------------------------------------------------------*/
 static inline void
 add_T_slot_measurement(rtimer_clock_t T_slot_measured)
 {
@@ -483,11 +514,26 @@ glossy_stop(void)
     g.active = 0;
 
     if(g.t_ref_updated) {
+#if GLOSSY_CONF_T_REF_AVG
+      /* average over all timestamps, each one shifted back to the start of
+       * the flood (relay counter 0), in fixed point */
+      int32_t T_slot_fp = (g.n_T_slot > 0) ? 
+                  (int32_t)((g.T_slot_sum << GLOSSY_T_REF_FP) / g.n_T_slot) :
+                  (int32_t)(g.T_slot_estimated << GLOSSY_T_REF_FP);
+      /* the sums may exceed 32 bits in fixed point */
+      int64_t ofs_fp = ((int64_t)g.t_ref_ofs_sum * (1 << GLOSSY_T_REF_FP) - 
+                        (int64_t)T_slot_fp * g.relay_cnt_ofs_sum) / 
+                       g.n_t_ref - (int64_t)T_slot_fp * g.relay_cnt_t_ref;
+      /* floor: the fraction must be positive */
+      g.t_ref += ofs_fp >> GLOSSY_T_REF_FP;
+      g.t_ref_frac = (uint8_t)(ofs_fp & ((1 << GLOSSY_T_REF_FP) - 1));
+#else /* GLOSSY_CONF_T_REF_AVG */
       if(g.n_T_slot > 0) {
         g.t_ref -= (g.relay_cnt_t_ref * g.T_slot_sum) / g.n_T_slot;
       } else {
         g.t_ref -= g.relay_cnt_t_ref * g.T_slot_estimated;
       }
+#endif /* GLOSSY_CONF_T_REF_AVG */
     }
 
     if(g.n_rx > 0) {
@@ -599,6 +645,16 @@ glossy_get_t_ref(void)
 }
 /*---------------------------------------------------------------------------*/
 uint8_t
+glossy_get_t_ref_frac(void)
+{
+#if GLOSSY_CONF_T_REF_AVG
+  return g.t_ref_frac;
+#else /* GLOSSY_CONF_T_REF_AVG */
+  return 0;
+#endif /* GLOSSY_CONF_T_REF_AVG */
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
 glossy_get_relay_cnt_first_rx(void)
 {
   return g.relay_cnt_first_rx;
@@ -750,6 +806,12 @@ rf1a_cb_rx_ended(rtimer_clock_t *timestamp, uint8_t *pkt, uint8_t pkt_len)
         update_t_ref(g.t_rx_start - NS_TO_RTIMER_HF(TAU1),
                      g.header.relay_cnt - 1);
       }
+#if GLOSSY_CONF_T_REF_AVG
+      else {
+        add_t_ref_measurement(g.t_rx_start - NS_TO_RTIMER_HF(TAU1),
+                              g.header.relay_cnt - 1);
+      }
+#endif /* GLOSSY_CONF_T_REF_AVG */
 
       if((g.relay_cnt_last_rx == g.relay_cnt_last_tx + 1) &&
          (g.n_tx > 0)) {
@@ -792,6 +854,11 @@ rf1a_cb_tx_ended(rtimer_clock_t *timestamp)
       /* t_ref has not been updated yet: update it */
       update_t_ref(g.t_tx_start, g.header.relay_cnt);
     }
+#if GLOSSY_CONF_T_REF_AVG
+    else {
+      add_t_ref_measurement(g.t_tx_start, g.header.relay_cnt);
+    }
+#endif /* GLOSSY_CONF_T_REF_AVG */
 
     if((g.relay_cnt_last_tx == g.relay_cnt_last_rx + 1) && (g.n_rx > 0)) {
       /* this transmission immediately followed a reception: measure T_slot */